@@ -169,14 +169,65 @@ numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target
 }
 
 
+// Pair used to sort the pivot indices by magnitude
+typedef struct{
+    numeric_type magnitude;
+    uint16_t index;
+} Abandon_order_entry;
+
+static int compare_abandon_order(const void *entry_1, const void *entry_2){
+    const numeric_type magnitude_1 = ((const Abandon_order_entry *) entry_1)->magnitude;
+    const numeric_type magnitude_2 = ((const Abandon_order_entry *) entry_2)->magnitude;
+    
+    if (magnitude_1 != magnitude_2)
+        return (magnitude_1 < magnitude_2) ? 1 : -1;
+    return (((const Abandon_order_entry *) entry_1)->index > ((const Abandon_order_entry *) entry_2)->index) ? 1 : -1;
+}
+
+
+// Indices of the z-normalized pivot sorted by decreasing |z| (UCR suite ordering)
+void abandon_order(const numeric_type *normalized_values, uint16_t length, uint16_t *order){
+    Abandon_order_entry *entries = safe_alloc(length * sizeof(*entries));
+    
+    for (uint16_t i = 0; i < length; i++){
+        entries[i].magnitude = fabs(normalized_values[i]);
+        entries[i].index = i;
+    }
+    qsort(entries, length, sizeof(*entries), compare_abandon_order);
+    for (uint16_t i = 0; i < length; i++)
+        order[i] = entries[i].index;
+    
+    free(entries);
+}
+
+
+// Euclidean distance with vanilla early abandon, visiting the elements in the order given by abandon_order
+numeric_type reordered_euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, const uint16_t *order, uint16_t length, numeric_type current_minimum_distance, uint32_t *abandon_position_addr){
+    numeric_type distance = 0.0;
+    
+    for (uint16_t i = 0; i < length; i++){
+        *abandon_position_addr = i;
+        distance += pow((double)(pivot_values[order[i]] - target_values[order[i]]), 2.0);
+        
+        if(distance >= current_minimum_distance)
+            return INFINITY;
+    }
+    
+    return distance;
+}
+
+
 // Distance from a shapelet to an entire time-series
-numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series, uint64_t *vanilla_count_addr, uint64_t *exp_count_addr, uint64_t *vanilla_positions_sum_addr, uint64_t *exp_positions_sum_addr){
+numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series, uint64_t *vanilla_count_addr, uint64_t *exp_count_addr, uint64_t *reordered_count_addr, 
+                                  uint64_t *vanilla_positions_sum_addr, uint64_t *exp_positions_sum_addr, uint64_t *reordered_positions_sum_addr){
     numeric_type shapelet_distance_vanilla, shapelet_distance_exp, minimum_distance;
     numeric_type *pivot_values, *target_values;                                              // we hold the shapelet values in a temporary vector so that we can manipulate and change this data without modifing the time series
     const uint32_t num_shapelets = time_series->length - pivot_shapelet->length + 1;         // number of shapelets of length "shapelet_len" in time_series    uint8_t print_flag;
     uint32_t closer_shapelet = 0;
     
-    uint32_t vanilla_abandon_position, exp_abandon_position;
+    uint32_t vanilla_abandon_position, exp_abandon_position, reordered_abandon_position;
+    numeric_type shapelet_distance_reordered;
+    uint16_t *pivot_order;
     
     // Initialized as inf to avoid if inside for
     minimum_distance = INFINITY;
@@ -186,6 +237,10 @@ numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *ti
     memcpy(pivot_values, &pivot_shapelet->Ti->values[pivot_shapelet->start_position], pivot_shapelet->length * sizeof(*pivot_values));
     
     zscore_normalization(pivot_values, pivot_shapelet->length);
+    
+    // Abandon order, computed once per normalized pivot
+    pivot_order = safe_alloc(pivot_shapelet->length * sizeof(*pivot_order));
+    abandon_order(pivot_values, pivot_shapelet->length, pivot_order);
 
     // Allocate memory for target values 
     // Pivot shapelet and ts shapelets must always have equal length
@@ -202,6 +257,7 @@ numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *ti
         // Compute vanilla shapelet-shapelet distance
         shapelet_distance_vanilla   = euclidean_distance(pivot_values, target_values, pivot_shapelet->length, minimum_distance, 0, &vanilla_abandon_position);
         shapelet_distance_exp       = euclidean_distance(pivot_values, target_values, pivot_shapelet->length, minimum_distance, 1, &exp_abandon_position);
+        shapelet_distance_reordered = reordered_euclidean_distance(pivot_values, target_values, pivot_order, pivot_shapelet->length, minimum_distance, &reordered_abandon_position);
         
         // printf("abandon pos: %d, %d\n", vanilla_abandon_position, exp_abandon_position);
         // if (exp_abandon_position != 0)
@@ -222,6 +278,11 @@ numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *ti
             *exp_count_addr = *exp_count_addr + 1;
             *exp_positions_sum_addr = *exp_positions_sum_addr + exp_abandon_position;
         }
+        
+        if (shapelet_distance_reordered == INFINITY){
+            *reordered_count_addr = *reordered_count_addr + 1;
+            *reordered_positions_sum_addr = *reordered_positions_sum_addr + reordered_abandon_position;
+        }
         // Keep the minimum distance between the pivot shapelet and all the time-series shapelets
         if (shapelet_distance_vanilla < minimum_distance){
             minimum_distance = shapelet_distance_vanilla;
@@ -232,6 +293,7 @@ numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *ti
 
     free(pivot_values);
     free(target_values);
+    free(pivot_order);
 
     return minimum_distance;
 }
@@ -332,9 +394,9 @@ Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t mi
     numeric_type *shapelet_distances;
     
     // Early abandon counting
-    uint64_t vanilla_count = 0, exp_count = 0;
+    uint64_t vanilla_count = 0, exp_count = 0, reordered_count = 0;
     // Early abandon leaving distance accumulation
-    uint64_t vanilla_positions_sum = 0, exp_positions_sum = 0;
+    uint64_t vanilla_positions_sum = 0, exp_positions_sum = 0, reordered_positions_sum = 0;
     
     //checks to assert if the parameters are valid
     if (min > max){
@@ -373,7 +435,7 @@ Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t mi
                 shapelet_distances = safe_alloc(num_ts * sizeof(*shapelet_distances));
                 // Calculate distances from current shapelet candidate to each time series in T, 
                 for (j = 0; j < num_ts; j++){
-                    shapelet_distances[j] = shapelet_ts_distance(&shapelet_candidate, &T[j], &vanilla_count, &exp_count, &vanilla_positions_sum, &exp_positions_sum);   
+                    shapelet_distances[j] = shapelet_ts_distance(&shapelet_candidate, &T[j], &vanilla_count, &exp_count, &reordered_count, &vanilla_positions_sum, &exp_positions_sum, &reordered_positions_sum);   
                 }
 
                 // F-Statistic as shapelet quality measure
@@ -399,10 +461,12 @@ Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t mi
     printf("[Abandon count]\n");
     printf("Full :%d\n", vanilla_count);
     printf("Exponent-only: %d\n", exp_count);
+    printf("Reordered: %d\n", reordered_count);
     
     printf("[Abandon positions sum]\n");
     printf("Full :%d\n", vanilla_positions_sum);
     printf("Exponent-only: %d\n", exp_positions_sum);
+    printf("Reordered: %d\n", reordered_positions_sum);
     
     return k_shapelets;
 }
@@ -66,8 +66,15 @@ void zscore_normalization(numeric_type *values, uint16_t length);
 // Euclidean distance between vectors with early abandon mechanisms
 numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, uint16_t length, numeric_type current_minimum_distance, uint8_t use_exp_ea, uint32_t *abandon_position_addr);
 
+// Indices of a z-normalized pivot sorted by decreasing |z|
+void abandon_order(const numeric_type *normalized_values, uint16_t length, uint16_t *order);
+
+// Euclidean distance with vanilla early abandon, visiting the elements in the order given by abandon_order
+numeric_type reordered_euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, const uint16_t *order, uint16_t length, numeric_type current_minimum_distance, uint32_t *abandon_position_addr);
+
 // Distance from a shapelet to an entire time-series
-numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series, uint64_t *vanilla_count_addr, uint64_t *exp_count_addr, uint64_t *vanilla_positions_sum_addr, uint64_t *exp_positions_sum_addr);
+numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series, uint64_t *vanilla_count_addr, uint64_t *exp_count_addr, uint64_t *reordered_count_addr, 
+                                  uint64_t *vanilla_positions_sum_addr, uint64_t *exp_positions_sum_addr, uint64_t *reordered_positions_sum_addr);
 
 // Normalization and distance from a shapelet to an entire time-series using dynamic programming algorithm proposed by (Chang, 2012)
 numeric_type dynamic_shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series);
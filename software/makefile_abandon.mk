@@ -0,0 +1,32 @@
+EXEC 		= abandon_benchmark
+CC			= gcc
+CFLAGS 		= -lm -Wall -pthread -O2 -std=gnu99 -fopenmp  #the benchmark reports throughput, so it is optimized
+DEFINES		= -DUSE_ZSCORE #add program related #define statements
+SRC_DIR 	= ./src
+# objects kept apart from the -O0 ones of the other makefiles
+BUILD_DIR 	= ./build/abandon
+BIN_DIR 	= ./bin
+SOURCES		= shapelet_transform.c fft.c simd_kernels.c scratch_arena.c thread_pool.c abandon_benchmark.c
+
+# create the obj variable by substituting the extension of the sources
+# and adding a path
+_OBJ = $(SOURCES:.c=.o) #changes the .c extension to .o extension from source file list
+OBJ = $(patsubst %,$(BUILD_DIR)/%,$(_OBJ))
+
+all: $(BIN_DIR)/$(EXEC)
+
+$(BIN_DIR)/$(EXEC): $(OBJ)
+	$(CC) $(DEFINES) -o $@ $^ $(CFLAGS)
+
+$(BUILD_DIR)/%.o: $(SRC_DIR)/%.c | $(BUILD_DIR)
+	$(CC) $(DEFINES) -c -o $@ $< $(CFLAGS)
+
+$(BUILD_DIR):
+	mkdir -p $@
+
+.PHONY: clean
+clean:
+	$(RM) *.o $(BIN_DIR)/$(EXEC) $(OBJ)
+.PHONY: clean_win
+clean_win: 
+	del *.o *.exe
@@ -5,24 +5,41 @@ DEFINES		= -DUSE_ZSCORE #add program related #define statements
 SRC_DIR 	= ./src
 BUILD_DIR 	= ./build
 BIN_DIR 	= ./bin
-SOURCES		=  shapelet_transform.c decision_functions.c profiling_aux.c tlp_prediction.c
+SOURCES		=  shapelet_transform.c fft.c simd_kernels.c scratch_arena.c thread_pool.c shapelet_variants.c decision_functions.c profiling_aux.c tlp_prediction.c
+# runtime selectable normalizations and distances (shapelet_variants.h), each one a build of shapelet_transform.c and profiling_aux.c
+VARIANTS	= algebric_pow algebric_abs zscore_pow zscore_abs zscore_expected_pow zscore_expected_abs
 
 # create the obj variable by substituting the extension of the sources
 # and adding a path
 _OBJ = $(SOURCES:.c=.o) #changes the .c extension to .o extension from source file list
 OBJ = $(patsubst %,$(BUILD_DIR)/%,$(_OBJ))
+VARIANT_OBJ = $(patsubst %,$(BUILD_DIR)/shapelet_transform_%.o,$(VARIANTS)) $(patsubst %,$(BUILD_DIR)/profiling_aux_%.o,$(VARIANTS))
+# the variant name replaces the normalization and distance defines
+VARIANT_DEFINES = $(filter-out -DUSE_ZSCORE -DUSE_EXPECTED_VALUE -DUSE_ABS,$(DEFINES)) -DSHAPELET_VARIANT=$* \
+                  $(if $(findstring zscore,$*),-DUSE_ZSCORE) $(if $(findstring expected,$*),-DUSE_EXPECTED_VALUE) $(if $(findstring abs,$*),-DUSE_ABS)
+# every global symbol of a variant object must carry the _<variant> suffix, otherwise it is missing from shapelet_variant_names.h
+VARIANT_SYMBOL_CHECK = @nm -g --defined-only $@ | awk '$$3 !~ /_$*$$/ {print "Error: " $$3 " of $@ is not renamed in shapelet_variant_names.h"; missing = 1} END {exit missing}' \
+                       || { $(RM) $@; exit 1; }
 
 all: $(BIN_DIR)/$(EXEC)
 
-$(BIN_DIR)/$(EXEC): $(OBJ)
+$(BIN_DIR)/$(EXEC): $(OBJ) $(VARIANT_OBJ)
 	$(CC) $(DEFINES) -o $@ $^ $(CFLAGS)
 
+$(BUILD_DIR)/shapelet_transform_%.o: $(SRC_DIR)/shapelet_transform.c
+	$(CC) $(VARIANT_DEFINES) -c -o $@ $< $(CFLAGS)
+	$(VARIANT_SYMBOL_CHECK)
+
+$(BUILD_DIR)/profiling_aux_%.o: $(SRC_DIR)/profiling_aux.c
+	$(CC) $(VARIANT_DEFINES) -c -o $@ $< $(CFLAGS)
+	$(VARIANT_SYMBOL_CHECK)
+
 $(BUILD_DIR)/%.o: $(SRC_DIR)/%.c 
 	$(CC) $(DEFINES) -c -o $@ $< $(CFLAGS)
 
 .PHONY: clean
 clean:
-	$(RM) *.o $(BIN_DIR)/$(EXEC) $(OBJ)
+	$(RM) *.o $(BIN_DIR)/$(EXEC) $(OBJ) $(VARIANT_OBJ)
 .PHONY: clean_win
 clean_win: 
 	del *.o *.exe
\ No newline at end of file
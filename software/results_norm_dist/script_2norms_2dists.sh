@@ -1,19 +1,19 @@
-./extract_shapelets_algebric_abs ../data/BirdChicken/BirdChicken_TRAIN.csv bird_alg_abs 3 512 20
-./extract_shapelets_algebric_pow ../data/BirdChicken/BirdChicken_TRAIN.csv bird_alg_pow 3 512 20
-./extract_shapelets_zscore_abs ../data/BirdChicken/BirdChicken_TRAIN.csv bird_z_abs 3 512 20
-./extract_shapelets_zscore_pow ../data/BirdChicken/BirdChicken_TRAIN.csv bird_z_pow 3 512 20
+./extract_shapelets ../data/BirdChicken/BirdChicken_TRAIN.csv bird_alg_abs 3 512 20 algebric_abs
+./extract_shapelets ../data/BirdChicken/BirdChicken_TRAIN.csv bird_alg_pow 3 512 20 algebric_pow
+./extract_shapelets ../data/BirdChicken/BirdChicken_TRAIN.csv bird_z_abs 3 512 20 zscore_abs
+./extract_shapelets ../data/BirdChicken/BirdChicken_TRAIN.csv bird_z_pow 3 512 20 zscore_pow
 
-./extract_shapelets_algebric_abs ../data/Coffee/Coffee_TRAIN.csv coffee_alg_abs 3 286 20
-./extract_shapelets_algebric_pow ../data/Coffee/Coffee_TRAIN.csv coffee_alg_pow 3 286 20
-./extract_shapelets_zscore_abs ../data/Coffee/Coffee_TRAIN.csv coffee_z_abs 3 286 20
-./extract_shapelets_zscore_pow ../data/Coffee/Coffee_TRAIN.csv coffee_z_pow 3 286 20
+./extract_shapelets ../data/Coffee/Coffee_TRAIN.csv coffee_alg_abs 3 286 20 algebric_abs
+./extract_shapelets ../data/Coffee/Coffee_TRAIN.csv coffee_alg_pow 3 286 20 algebric_pow
+./extract_shapelets ../data/Coffee/Coffee_TRAIN.csv coffee_z_abs 3 286 20 zscore_abs
+./extract_shapelets ../data/Coffee/Coffee_TRAIN.csv coffee_z_pow 3 286 20 zscore_pow
 
-./extract_shapelets_algebric_abs ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_alg_abs 3 82 20
-./extract_shapelets_algebric_pow ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_alg_pow 3 82 20
-./extract_shapelets_zscore_abs ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_z_abs 3 82 20
-./extract_shapelets_zscore_pow ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_z_pow 3 82 20
+./extract_shapelets ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_alg_abs 3 82 20 algebric_abs
+./extract_shapelets ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_alg_pow 3 82 20 algebric_pow
+./extract_shapelets ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_z_abs 3 82 20 zscore_abs
+./extract_shapelets ../data/TwoLeadECG/TwoLeadECG_TRAIN.csv ecg_z_pow 3 82 20 zscore_pow
 
-./extract_shapelets_algebric_abs ../data/Wafer/Wafer_TRAIN.csv wafer_algebric_abs 3 152 20
-./extract_shapelets_algebric_pow ../data/Wafer/Wafer_TRAIN.csv wafer_algebric_pow 3 152 20
-./extract_shapelets_zscore_abs ../data/Wafer/Wafer_TRAIN.csv wafer_zscore_abs 3 152 20
-./extract_shapelets_zscore_pow ../data/Wafer/Wafer_TRAIN.csv wafer_zscore_pow 3 152 20
+./extract_shapelets ../data/Wafer/Wafer_TRAIN.csv wafer_algebric_abs 3 152 20 algebric_abs
+./extract_shapelets ../data/Wafer/Wafer_TRAIN.csv wafer_algebric_pow 3 152 20 algebric_pow
+./extract_shapelets ../data/Wafer/Wafer_TRAIN.csv wafer_zscore_abs 3 152 20 zscore_abs
+./extract_shapelets ../data/Wafer/Wafer_TRAIN.csv wafer_zscore_pow 3 152 20 zscore_pow
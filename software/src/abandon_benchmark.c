@@ -0,0 +1,207 @@
+// Copyright GMicro UFSM 2020.
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "shapelet_transform.h"
+#include "simd_kernels.h"
+#include <omp.h>
+
+// Compares the exact early abandon of the distance kernels with the exponent one of shapelet_distance.vhd (USE_EXPONENT_ABANDON)
+// For each dataset, candidates sampled across the series are scanned window by window against every time series, once per abandon mode,
+// reporting the fraction of windows abandoned and the windows evaluated per second
+// The vector kernels are called directly, whatever USE_SIMD says, so the program is only defined in floating point (no USE_FIXED)
+
+// Candidates sampled for each shapelet length
+#define BENCHMARK_CANDIDATES 16
+
+static const char *abandon_mode_names[] = {"exact", "exponent"};
+
+typedef struct{
+    uint64_t num_windows;
+    uint64_t num_abandoned;             // Windows abandoned by a block check, before the last element
+    uint64_t num_elements;              // Elements accumulated by the kernel
+    uint64_t num_window_elements;       // Elements of all the windows
+    double time;
+} Abandon_counters;
+
+
+// Number of elements the kernel accumulates before abandoning, replaying its block checks on lanes lanes (untimed, for the counters)
+// Element i is accumulated in lane i % lanes, the exact check compares the sum of the lanes and the exponent one each lane
+static uint32_t abandon_position(const numeric_type *candidate, const numeric_type *target_values, uint32_t length, numeric_type offset, numeric_type scale, 
+                                 numeric_type current_minimum_distance, Simd_abandon_mode abandon_mode, uint32_t lanes){
+    float lane_sums[16] = {0}, total, difference;
+    uint32_t minimum_bits, lane_bits;
+    int abandoned;
+    
+    memcpy(&minimum_bits, &current_minimum_distance, sizeof(minimum_bits));
+    for (uint32_t i = 0; i + SIMD_ABANDON_BLOCK < length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i++){
+            difference = candidate[i] - (target_values[i] - offset) * scale;
+            #ifdef USE_ABS
+            lane_sums[i % lanes] += fabsf(difference);
+            #else
+            lane_sums[i % lanes] += difference * difference;
+            #endif
+        }
+        total = 0;
+        abandoned = 0;
+        for (uint32_t l = 0; l < lanes; l++){
+            total += lane_sums[l];
+            memcpy(&lane_bits, &lane_sums[l], sizeof(lane_bits));
+            abandoned |= (lane_bits > (minimum_bits | 0x007FFFFF));
+        }
+        if ((abandon_mode == SIMD_ABANDON_EXACT) ? total >= current_minimum_distance : abandoned)
+            return i;
+    }
+    
+    return length;
+}
+
+
+// Minimum distance of a normalized candidate to each time series, counting the windows abandoned by the kernel
+static void candidate_minimum_distances(const numeric_type *candidate, uint32_t length, const Timeseries *T, uint16_t num_ts, 
+                                        Simd_abandon_mode abandon_mode, numeric_type *minimum_distances, double *time){
+    double window_sum = 0.0, window_squares_sum = 0.0;
+    numeric_type offset, scale, distance, minimum_distance;
+    
+    *time = omp_get_wtime();
+    for (uint16_t j = 0; j < num_ts; j++){
+        minimum_distance = INFINITY;
+        for (uint32_t w = 0; w + length <= T[j].length; w++){
+            window_sums(&T[j], w, length, &window_sum, &window_squares_sum);
+            window_normalization_stats(window_sum, window_squares_sum, length, &offset, &scale);
+            #ifdef USE_ABS
+            distance = simd_absolute_distance(candidate, &T[j].values[w], length, offset, scale, minimum_distance, abandon_mode);
+            #else
+            distance = simd_squared_distance(candidate, &T[j].values[w], length, offset, scale, minimum_distance, abandon_mode);
+            #endif
+            if (distance < minimum_distance)
+                minimum_distance = distance;
+        }
+        minimum_distances[j] = minimum_distance;
+    }
+    *time = omp_get_wtime() - *time;
+}
+
+
+// Replays the scan of candidate_minimum_distances, counting where each window is abandoned
+static void count_abandons(const numeric_type *candidate, uint32_t length, const Timeseries *T, uint16_t num_ts, 
+                           Simd_abandon_mode abandon_mode, uint32_t lanes, Abandon_counters *counters){
+    double window_sum = 0.0, window_squares_sum = 0.0;
+    numeric_type offset, scale, distance, minimum_distance;
+    uint32_t position;
+    
+    for (uint16_t j = 0; j < num_ts; j++){
+        minimum_distance = INFINITY;
+        for (uint32_t w = 0; w + length <= T[j].length; w++){
+            window_sums(&T[j], w, length, &window_sum, &window_squares_sum);
+            window_normalization_stats(window_sum, window_squares_sum, length, &offset, &scale);
+            position = abandon_position(candidate, &T[j].values[w], length, offset, scale, minimum_distance, abandon_mode, lanes);
+            counters->num_abandoned += (position < length);
+            counters->num_elements += position;
+            #ifdef USE_ABS
+            distance = simd_absolute_distance(candidate, &T[j].values[w], length, offset, scale, minimum_distance, abandon_mode);
+            #else
+            distance = simd_squared_distance(candidate, &T[j].values[w], length, offset, scale, minimum_distance, abandon_mode);
+            #endif
+            if (distance < minimum_distance)
+                minimum_distance = distance;
+        }
+        counters->num_windows += T[j].length - length + 1;
+        counters->num_window_elements += (uint64_t) (T[j].length - length + 1) * length;
+    }
+}
+
+
+static void benchmark_dataset(char *filename, uint16_t min_len, uint16_t max_len){
+    Abandon_counters counters[2] = {{0}};
+    uint64_t num_mismatches = 0;
+    uint32_t num_positions, sample, lanes;
+    uint16_t num_ts, series;
+    Timeseries *T;
+    
+    num_ts = read_dataset(filename, &T);
+    build_stats_index(T, num_ts, STATS_INDEX_MAX_BYTES);
+    // Lengths beyond the time series are skipped, so that datasets of different lengths share a command line
+    if (T[0].length < max_len)
+        max_len = T[0].length;
+    
+    // Lanes of the accumulator of the selected kernels
+    lanes = (strcmp(simd_kernels_isa(), "avx512") == 0) ? 16 : (strcmp(simd_kernels_isa(), "avx2") == 0) ? 8 : 1;
+    
+    numeric_type *candidate = safe_alloc(max_len * sizeof(*candidate));
+    numeric_type *minimum_distances[2];
+    for (int mode = 0; mode < 2; mode++)
+        minimum_distances[mode] = safe_alloc(num_ts * sizeof(*minimum_distances[mode]));
+    
+    for (uint16_t length = min_len; length <= max_len; length++){
+        // Candidates spread evenly over every (series, position) pair
+        num_positions = T[0].length - length + 1;
+        for (uint32_t c = 0; c < BENCHMARK_CANDIDATES; c++){
+            sample = (uint32_t) (((uint64_t) c * num_ts * num_positions) / BENCHMARK_CANDIDATES);
+            series = sample / num_positions;
+            normalized_copy(&T[series].values[sample % num_positions], length, candidate);
+            
+            for (int mode = 0; mode < 2; mode++){
+                double time;
+                candidate_minimum_distances(candidate, length, T, num_ts, (Simd_abandon_mode) mode, minimum_distances[mode], &time);
+                counters[mode].time += time;
+                count_abandons(candidate, length, T, num_ts, (Simd_abandon_mode) mode, lanes, &counters[mode]);
+            }
+            for (uint16_t j = 0; j < num_ts; j++)
+                num_mismatches += (minimum_distances[0][j] != minimum_distances[1][j]);
+        }
+    }
+    
+    printf("%s (%u time series of length %u, shapelets of %u to %u)\n", filename, num_ts, T[0].length, min_len, max_len);
+    if (counters[0].num_windows == 0)
+        printf("    no shapelet length fits\n");
+    else{
+        for (int mode = 0; mode < 2; mode++)
+            printf("    %-8s abandon rate %6.2f%%, elements accumulated %6.2f%%, %8.2f Mwindows/s\n", abandon_mode_names[mode], 
+                   100.0 * counters[mode].num_abandoned / counters[mode].num_windows, 
+                   100.0 * counters[mode].num_elements / counters[mode].num_window_elements, 
+                   counters[mode].num_windows / counters[mode].time / 1e6);
+        printf("    speedup %.3f, minimum distance mismatches %llu\n", counters[0].time / counters[1].time, (unsigned long long) num_mismatches);
+    }
+    
+    for (int mode = 0; mode < 2; mode++)
+        free(minimum_distances[mode]);
+    free(candidate);
+    free_stats_index(T, num_ts);
+    for (unsigned int i = 0; i < num_ts; i++)
+        free(T[i].values);
+    free(T);
+}
+
+
+int main(int argc, char *argv[]){
+    uint16_t min_len, max_len;
+    
+    if(argc < 4){
+        printf("Please use: %s {min_len} {max_len} {path_to_dataset} [path_to_dataset ...]\n", argv[0]);
+        exit(-1);
+    }
+    min_len = (uint16_t) atoi(argv[1]);
+    max_len = (uint16_t) atoi(argv[2]);
+    if (min_len < 3 || min_len > max_len){
+        printf("Error: lengths must satisfy 3 <= min_len <= max_len\n");
+        exit(-1);
+    }
+    
+    printf("Distance kernels: %s, abandon check every %u elements\n", simd_kernels_isa(), SIMD_ABANDON_BLOCK);
+    for (int i = 3; i < argc; i++)
+        benchmark_dataset(argv[i], min_len, max_len);
+    
+    return 0;
+}
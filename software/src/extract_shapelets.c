@@ -13,6 +13,7 @@
 
 
 #include "shapelet_transform.h"
+#include "shapelet_variants.h"
 #include <stdio.h>
 // used to set the floating point rounding mode
 #include <fenv.h>  // use -lm during compilaton to link this library
@@ -28,10 +29,12 @@ int main(int argc, char *argv[]){
     //Timeseries T[NUM_SERIES];
     Timeseries *T;
     char * infilename, *outfilename;
+    Shapelet_config config = default_shapelet_config();
 
-    // Get filenames and k from argv
-    if(argc != 6){
-        printf("Please use: %s {path_to_dataset} {output_basename} {min_len} {max_len} {k_best}\n", argv[0]);
+    // Get filenames and k from argv, and optionally the normalization and distance (the ones of the build by default)
+    if(argc != 6 && argc != 7){
+        printf("Please use: %s {path_to_dataset} {output_basename} {min_len} {max_len} {k_best} [variant]\n", argv[0]);
+        printf("variant: algebric_pow, algebric_abs, zscore_pow, zscore_abs, zscore_expected_pow or zscore_expected_abs\n");
         exit(-1);
     }
 
@@ -45,9 +48,17 @@ int main(int argc, char *argv[]){
         printf("Error: k must be greater than zero\n");
         exit(-1);
     }
+    if(argc == 7 && !parse_shapelet_config(argv[6], &config)){
+        printf("Error: unknown variant %s\n", argv[6]);
+        exit(-1);
+    }
+    printf("Variant: %s\n", shapelet_config_name(&config));
     
     // Load dataset and hold number of time-series loaded
     num_ts = read_dataset(infilename, &T);
+    // The time series of each class are kept together, so the class distances are reduced by contiguous runs
+    sort_dataset_by_class(T, num_ts);
+    build_stats_index(T, num_ts, STATS_INDEX_MAX_BYTES);
     if (T[0].length < max_len){
         printf("Error, maximum shapelet length is greater than each time-series length");
         exit(-1);
@@ -60,10 +71,11 @@ int main(int argc, char *argv[]){
     Shapelet *k_best = malloc(k * sizeof(*k_best));
 
     //k_best = multi_thread_shapelet_cached_selection(T, num_ts, min_len, max_len, k, 2);
-    k_best = omp_shapelet_cached_selection(T, num_ts, min_len, max_len, k);
+    k_best = config_omp_shapelet_cached_selection(&config, T, num_ts, min_len, max_len, k);
 
     shapelet_set_to_files(k_best, k, T, outfilename);
     
+    free_stats_index(T, num_ts);
     for (unsigned int i = 0; i < num_ts; i++){
         free(T[i].values);
     }
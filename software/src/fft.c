@@ -0,0 +1,106 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "fft.h"
+#include <stdio.h>
+#include <errno.h>
+
+// Smallest power of two greater than or equal to value
+uint32_t next_power_of_two(uint32_t value){
+    uint32_t power = 1;
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+
+
+// Twiddle factors cos(2 pi k / length) and sin(2 pi k / length), k < length / 2, of the largest length transformed by the thread
+// A transform of a smaller length n reads them with a stride of length / n, so the table is only rebuilt when a longer one comes
+typedef struct{
+    double *cos;
+    double *sin;
+    uint32_t length;
+} Twiddle_table;
+
+static __thread Twiddle_table twiddles = {NULL, NULL, 0};
+
+
+static void twiddles_grow(uint32_t length){
+    free(twiddles.cos);
+    free(twiddles.sin);
+    twiddles.cos = malloc((length / 2) * sizeof(*twiddles.cos));
+    twiddles.sin = malloc((length / 2) * sizeof(*twiddles.sin));
+    if (twiddles.cos == NULL || twiddles.sin == NULL){
+        perror("Error allocating FFT twiddle factors!\n");
+        exit(errno);
+    }
+    for (uint32_t k = 0; k < length / 2; k++){
+        twiddles.cos[k] = cos(2.0 * M_PI * k / length);
+        twiddles.sin[k] = sin(2.0 * M_PI * k / length);
+    }
+    twiddles.length = length;
+}
+
+
+void fft_free_twiddles(void){
+    free(twiddles.cos);
+    free(twiddles.sin);
+    twiddles.cos = NULL;
+    twiddles.sin = NULL;
+    twiddles.length = 0;
+}
+
+
+// In-place iterative radix-2 FFT (Cooley-Tukey, decimation in time)
+void fft(double *real, double *imag, uint32_t length, uint8_t inverse){
+    const double sign = inverse ? 1.0 : -1.0;
+    uint32_t table_stride;
+    double temp;
+    
+    if (length < 2)
+        return;
+    
+    // Bit-reversal permutation
+    for (uint32_t i = 1, j = 0; i < length; i++){
+        uint32_t bit = length >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j){
+            temp = real[i]; real[i] = real[j]; real[j] = temp;
+            temp = imag[i]; imag[i] = imag[j]; imag[j] = temp;
+        }
+    }
+    
+    if (length > twiddles.length)
+        twiddles_grow(length);
+    table_stride = twiddles.length / length;
+    
+    // Butterflies, the stages of size 2 * half use every (length / (2 * half))-th twiddle factor of this length
+    for (uint32_t half = 1; half < length; half <<= 1){
+        const uint32_t stride = table_stride * (length / (2 * half));
+        for (uint32_t start = 0; start < length; start += 2 * half){
+            for (uint32_t k = 0; k < half; k++){
+                const uint32_t top = start + k, bottom = start + k + half;
+                const double w_real = twiddles.cos[k * stride], w_imag = sign * twiddles.sin[k * stride];
+                const double product_real = real[bottom] * w_real - imag[bottom] * w_imag;
+                const double product_imag = real[bottom] * w_imag + imag[bottom] * w_real;
+                real[bottom] = real[top] - product_real;
+                imag[bottom] = imag[top] - product_imag;
+                real[top] += product_real;
+                imag[top] += product_imag;
+            }
+        }
+    }
+}
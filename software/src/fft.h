@@ -0,0 +1,33 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _FFT_H
+#define _FFT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Smallest power of two greater than or equal to value
+uint32_t next_power_of_two(uint32_t value);
+
+// In-place iterative radix-2 FFT of a complex vector given by its real and imaginary parts
+// The twiddle factors are computed once per thread for the largest length transformed, and reused by every later transform
+// length must be a power of two. When inverse is set, the unnormalized inverse transform is computed (divide by length afterwards)
+void fft(double *real, double *imag, uint32_t length, uint8_t inverse);
+
+// Frees the twiddle factors of the calling thread (before the thread exits)
+void fft_free_twiddles(void);
+
+#endif
@@ -26,9 +26,22 @@ int main(int argc, char *argv[]){
     numeric_type **transformed_dataset;
     float coefficient_vector[] = {-0.3231, -0.0882, 0.3912, -0.4085, -0.1971, 0.4187, 0.2481, -0.3782, 0.0274, 0.2563, 0.0705, -0.2876, 0.0884, 0.3504, 0.471, 0.1362, -0.2665, -0.0046, -0.3454, -0.4375, 0.2649, 0.099, -0.478, 0.3778, 0.0949, 0.4118, -0.2697, 0.4153, -0.2043, 0.1931, 0.1049, 0.0274, -0.2616, -0.3808, -0.0066, 0.2419, 0.0981, 0.3249, -0.457, 0.2094, -0.2065, 0.1235, 0.2877, -0.0819, -0.2903, -0.4882, 0.2769, 0.4899, -0.1204, -0.2903};
     uint8_t *prediction_array;
+    Shapelet_config config = default_shapelet_config();
+    
+    // Optionally the normalization and distance of the shapelets (the ones of the build by default)
+    if(argc > 2){
+        printf("Please use: %s [variant]\n", argv[0]);
+        printf("variant: algebric_pow, algebric_abs, zscore_pow, zscore_abs, zscore_expected_pow or zscore_expected_abs\n");
+        exit(-1);
+    }
+    if(argc == 2 && !parse_shapelet_config(argv[1], &config)){
+        printf("Error: unknown variant %s\n", argv[1]);
+        exit(-1);
+    }
     
     // Load dataset
     num_ts = read_dataset(dataset_filename, &ts_dataset);
+    build_stats_index(ts_dataset, num_ts, STATS_INDEX_MAX_BYTES);
     
     // Load shapelet set
     shapelet_array = safe_alloc(num_shapelets * sizeof(*shapelet_array));
@@ -40,15 +53,15 @@ int main(int argc, char *argv[]){
     
     // printf("Normalized shapelets\n");
     for (uint16_t i = 0; i < num_shapelets; i++){
-        zscore_normalization(normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
+        config_normalize_values(&config, normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
         
         // printf("[%u] Length: %u, first: %g, last: %g\n", i, normalized_shapelet_array[i].length,
                 // normalized_shapelet_array[i].values[0], normalized_shapelet_array[i].values[normalized_shapelet_array[i].length - 1]);
         // comp_mean_std(normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
     }
     
-    // Transform the dataset with the already normalized shapelets
-    transformed_dataset = profiling_transform_dataset(ts_dataset, num_ts, normalized_shapelet_array, num_shapelets);
+    // Transform the dataset with the already normalized shapelets (normalized and compared by the same variant)
+    transformed_dataset = config_profiling_transform_dataset(&config, ts_dataset, num_ts, normalized_shapelet_array, num_shapelets);
     
     
     prediction_array = linear_decision(transformed_dataset, num_ts, coefficient_vector, num_shapelets);
@@ -15,7 +15,7 @@
 
 // Returns a new shapelet_profiling instance
 // The inputs are an oversized buffer and the actual shapelet length
-Shapelet_profiling profiling_init_shapelet(numeric_type **shapelet_values_buffer, uint16_t shapelet_len, numeric_type **shapelet_values){
+Shapelet_profiling profiling_init_shapelet(numeric_type **shapelet_values_buffer, uint32_t shapelet_len, numeric_type **shapelet_values){
     Shapelet_profiling shapelet;
     
     *shapelet_values = safe_alloc(shapelet_len * sizeof(**shapelet_values) );
@@ -107,11 +107,44 @@ void read_shapelets(const char *filename, Shapelet_profiling **shapelet_array){
 
 // Distance from a shapelet to an entire time-series
 numeric_type profiling_shapelet_ts_distance(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series){
-    numeric_type shapelet_distance, minimum_distance;
-    numeric_type *subsequence_values;                                              
+    uint32_t best_window;
+    
+    return profiling_shapelet_ts_distance_profile(normalized_shapelet, time_series, &best_window, NULL);
+}
+
+
+// Without a profile each window distance is abandoned once it exceeds the minimum so far, otherwise it is computed in full
+numeric_type profiling_shapelet_ts_distance_profile(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series, 
+                                                   uint32_t *best_window, numeric_type *distance_profile){
+    numeric_type shapelet_distance, minimum_distance, abandon_distance;
     const uint32_t num_shapelets = time_series->length - normalized_shapelet->length + 1;         
     
     minimum_distance = INFINITY;
+    abandon_distance = INFINITY;
+    *best_window = 0;
+    
+    #if defined(USE_SLIDING_STATS) && defined(USE_ZSCORE) && !defined(USE_FIXED)
+    // Windows are normalized on the fly with the statistics read from the index (or running sums when the series has none)
+    double window_sum, window_squares_sum;
+    numeric_type offset, scale;
+    
+    for(uint32_t i=0; i<num_shapelets; i++){
+        window_sums(time_series, i, normalized_shapelet->length, &window_sum, &window_squares_sum);
+        window_normalization_stats(window_sum, window_squares_sum, normalized_shapelet->length, &offset, &scale);
+        
+        shapelet_distance = window_euclidean_distance(normalized_shapelet->values, &time_series->values[i], normalized_shapelet->length, offset, scale, abandon_distance);
+        if (distance_profile != NULL)
+            distance_profile[i] = shapelet_distance;
+        if (shapelet_distance < minimum_distance){
+            minimum_distance = shapelet_distance;
+            *best_window = i;
+            if (distance_profile == NULL)
+                abandon_distance = minimum_distance;
+        }
+    }
+    
+    #else
+    numeric_type *subsequence_values;                                              
     
     // Allocate memory for target values 
     // Pivot shapelet and ts shapelets must always have equal length
@@ -119,22 +152,25 @@ numeric_type profiling_shapelet_ts_distance(Shapelet_profiling *normalized_shape
 
     // Loops over shapelets in the time-series
     for(uint32_t i=0; i<num_shapelets; i++){
-        // initialize normalized values of time series shapelet starting at i
-        memcpy(subsequence_values, &time_series->values[i], normalized_shapelet->length * sizeof(*subsequence_values));
-        
-        // Normalize target shapelet values
-        zscore_normalization(subsequence_values, normalized_shapelet->length);
+        // initialize normalized values of time series shapelet starting at i, normalized as the shapelets of the build
+        normalized_copy(&time_series->values[i], normalized_shapelet->length, subsequence_values);
         
         // Compute shapelet-shapelet distance
-        shapelet_distance = euclidean_distance(normalized_shapelet->values, subsequence_values, normalized_shapelet->length, minimum_distance);
+        shapelet_distance = euclidean_distance(normalized_shapelet->values, subsequence_values, normalized_shapelet->length, abandon_distance);
         
         // Keep the minimum distance between the pivot shapelet and all the time-series shapelets
+        if (distance_profile != NULL)
+            distance_profile[i] = shapelet_distance;
         if (shapelet_distance < minimum_distance){
             minimum_distance = shapelet_distance;
+            *best_window = i;
+            if (distance_profile == NULL)
+                abandon_distance = minimum_distance;
         }    
     }
 
     free(subsequence_values);
+    #endif
 
     return minimum_distance;
 }
@@ -158,8 +194,77 @@ numeric_type **profiling_transform_dataset(Timeseries *T, uint16_t num_ts, Shape
     return transformed_data;
 }
 
+
+// Same transform, with the best match windows in the same pass
+numeric_type **profiling_transform_dataset_locations(Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets, 
+                                                     uint32_t ***match_windows){
+    numeric_type **transformed_data;
+    
+    transformed_data = safe_alloc(num_ts * sizeof(*transformed_data));
+    *match_windows = safe_alloc(num_ts * sizeof(**match_windows));
+    for (uint16_t i = 0; i < num_ts; i++){
+        transformed_data[i] = safe_alloc(num_shapelets * sizeof(**transformed_data));
+        (*match_windows)[i] = safe_alloc(num_shapelets * sizeof(***match_windows));
+    }
+    
+    for (uint16_t i = 0; i < num_ts; i++){
+        for (uint16_t j = 0; j < num_shapelets; j++){
+            transformed_data[i][j] = profiling_shapelet_ts_distance_profile(&normalized_shapelets[j], &T[i], &(*match_windows)[i][j], NULL);
+        }
+    }
+    
+    return transformed_data;
+}
+
+#ifndef SHAPELET_VARIANT
+// Functions of each variant build of this file (shapelet_variant_names.h)
+#define DECLARE_PROFILING_VARIANT(variant) \
+    numeric_type profiling_shapelet_ts_distance_##variant(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series); \
+    numeric_type profiling_shapelet_ts_distance_profile_##variant(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series, \
+                                                                 uint32_t *best_window, numeric_type *distance_profile); \
+    numeric_type **profiling_transform_dataset_##variant(Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets); \
+    numeric_type **profiling_transform_dataset_locations_##variant(Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, \
+                                                                   uint16_t num_shapelets, uint32_t ***match_windows);
+SHAPELET_VARIANTS(DECLARE_PROFILING_VARIANT)
+
+typedef struct{
+    numeric_type (*ts_distance)(Shapelet_profiling *, const Timeseries *);
+    numeric_type (*ts_distance_profile)(Shapelet_profiling *, const Timeseries *, uint32_t *, numeric_type *);
+    numeric_type **(*transform)(Timeseries *, uint16_t, Shapelet_profiling *, uint16_t);
+    numeric_type **(*transform_locations)(Timeseries *, uint16_t, Shapelet_profiling *, uint16_t, uint32_t ***);
+} Profiling_variant;
+
+#define PROFILING_VARIANT_ENTRY(variant) \
+    {profiling_shapelet_ts_distance_##variant, profiling_shapelet_ts_distance_profile_##variant, profiling_transform_dataset_##variant, \
+     profiling_transform_dataset_locations_##variant},
+static const Profiling_variant profiling_variants[] = {SHAPELET_VARIANTS(PROFILING_VARIANT_ENTRY)};
+
+
+numeric_type config_profiling_shapelet_ts_distance(const Shapelet_config *config, Shapelet_profiling *normalized_shapelet, const Timeseries *time_series){
+    return profiling_variants[shapelet_variant_index(config)].ts_distance(normalized_shapelet, time_series);
+}
+
+
+numeric_type config_profiling_shapelet_ts_distance_profile(const Shapelet_config *config, Shapelet_profiling *normalized_shapelet, 
+                                                          const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile){
+    return profiling_variants[shapelet_variant_index(config)].ts_distance_profile(normalized_shapelet, time_series, best_window, distance_profile);
+}
+
+
+numeric_type **config_profiling_transform_dataset(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, 
+                                                  uint16_t num_shapelets){
+    return profiling_variants[shapelet_variant_index(config)].transform(T, num_ts, normalized_shapelets, num_shapelets);
+}
+
+
+numeric_type **config_profiling_transform_dataset_locations(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, 
+                                                            Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets, uint32_t ***match_windows){
+    return profiling_variants[shapelet_variant_index(config)].transform_locations(T, num_ts, normalized_shapelets, num_shapelets, match_windows);
+}
+#endif
+
 // // Compute mean and std
-void comp_mean_std(numeric_type *values, uint16_t length){
+void comp_mean_std(numeric_type *values, uint32_t length){
     numeric_type mean, std;
     
     // Computation of standard deviation by sample formula
@@ -167,14 +272,14 @@ void comp_mean_std(numeric_type *values, uint16_t length){
     
     // calculate arithmetic mean 
     mean = 0;
-    for(uint16_t i=0; i < length; i++){
+    for(uint32_t i=0; i < length; i++){
         mean += values[i];
     }
     mean /= length;
     
     // calculate sum (xi - mean)^2
     differrence_sum = 0;
-    for(uint16_t i=0; i < length; i++){
+    for(uint32_t i=0; i < length; i++){
         differrence_sum += pow(values[i] - mean, 2);
     }
     // divide sum by N - 1 
@@ -22,18 +22,19 @@
 #include <fenv.h>  // use -lm during compilaton to link this library
 
 #include "shapelet_transform.h"
+#include "shapelet_variants.h"
 #include "decision_functions.h"
 
 // Shapelet structure similar to the time-series structure in shapelet_transform.h
 typedef struct{
     //uint8_t class;                      // The class of the time-series from which the shapelet was extracted
-    uint16_t length;                    // Number of points in time series
+    uint32_t length;                    // Number of points in time series
     numeric_type *values;               // The shapelet itself
 } Shapelet_profiling;
 
 // Returns a new shapelet_profiling instance
 // The inputs are an oversized buffer and the actual shapelet length
-Shapelet_profiling profiling_init_shapelet(numeric_type **shapelet_values_buffer, uint16_t shapelet_len, numeric_type **shapelet_values);
+Shapelet_profiling profiling_init_shapelet(numeric_type **shapelet_values_buffer, uint32_t shapelet_len, numeric_type **shapelet_values);
 
 // Reads a CSV with one shapelet in each line
 void read_shapelets(const char *filename, Shapelet_profiling **shapelet_array);
@@ -41,11 +42,31 @@ void read_shapelets(const char *filename, Shapelet_profiling **shapelet_array);
 // Distance from a shapelet to an entire time-series
 numeric_type profiling_shapelet_ts_distance(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series);
 
+// Same distance, with the window where the shapelet matches best in *best_window, and the distance to every window in 
+// distance_profile when it is not NULL (time_series->length - length + 1 elements allocated by the caller)
+numeric_type profiling_shapelet_ts_distance_profile(Shapelet_profiling *normalized_shapelet, const Timeseries *time_series, 
+                                                   uint32_t *best_window, numeric_type *distance_profile);
+
 // Transform set of time-series based on the distances to a set o shapelets (the Transform of the ST)
 numeric_type **profiling_transform_dataset(Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets);
 
+// Same transform, with the location features: (*match_windows)[i][j] is the window of T[i] where shapelet j matches best
+// (FREE AS THE TRANSFORMED DATA)
+numeric_type **profiling_transform_dataset_locations(Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets, 
+                                                     uint32_t ***match_windows);
+
+// Same as the functions above, computed by the variant of config (shapelet_variants.h). The shapelets must be normalized
+// with the same config (config_normalize_values)
+numeric_type config_profiling_shapelet_ts_distance(const Shapelet_config *config, Shapelet_profiling *normalized_shapelet, const Timeseries *time_series);
+numeric_type config_profiling_shapelet_ts_distance_profile(const Shapelet_config *config, Shapelet_profiling *normalized_shapelet, 
+                                                          const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile);
+numeric_type **config_profiling_transform_dataset(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet_profiling *normalized_shapelets, 
+                                                  uint16_t num_shapelets);
+numeric_type **config_profiling_transform_dataset_locations(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, 
+                                                            Shapelet_profiling *normalized_shapelets, uint16_t num_shapelets, uint32_t ***match_windows);
+
 // // Compute mean and std
-void comp_mean_std(numeric_type *values, uint16_t length);
+void comp_mean_std(numeric_type *values, uint32_t length);
 
 void print_float_array(float * vec, size_t size);
 
@@ -0,0 +1,83 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "scratch_arena.h"
+#include <stdio.h>
+#include <errno.h>
+
+typedef struct{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} Scratch_arena;
+
+static __thread Scratch_arena arena = {NULL, 0, 0};
+
+
+void scratch_reserve(size_t size){
+    if (size <= arena.size)
+        return;
+    
+    if (arena.used != 0){
+        printf("Error, scratch arena cannot grow while in use (%zu of %zu bytes used, %zu requested)\n", arena.used, arena.size, size);
+        exit(-1);
+    }
+    
+    free(arena.base);
+    // Aligned base, so that the offsets rounded to SCRATCH_ALIGNMENT give aligned blocks
+    if (posix_memalign((void **) &arena.base, SCRATCH_ALIGNMENT, size) != 0){
+        perror("Error allocating scratch arena!\n");
+        exit(errno);
+    }
+    arena.size = size;
+}
+
+
+void scratch_destroy(void){
+    free(arena.base);
+    arena.base = NULL;
+    arena.size = 0;
+    arena.used = 0;
+}
+
+
+size_t scratch_mark(void){
+    return arena.used;
+}
+
+
+void scratch_release(size_t mark){
+    if (mark < arena.used)
+        arena.used = mark;
+}
+
+
+void scratch_release_from(const void *block){
+    scratch_release((size_t) ((const uint8_t *) block - arena.base));
+}
+
+
+void *scratch_alloc(size_t size){
+    const size_t aligned_size = scratch_block_size(size);
+    void *block;
+    
+    if (arena.used + aligned_size > arena.size){
+        printf("Error, scratch arena exhausted (%zu of %zu bytes used, %zu requested)\n", arena.used, arena.size, size);
+        exit(-1);
+    }
+    
+    block = arena.base + arena.used;
+    arena.used += aligned_size;
+    return block;
+}
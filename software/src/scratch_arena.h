@@ -0,0 +1,52 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _SCRATCH_ARENA_H
+#define _SCRATCH_ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Alignment of every block drawn from the arena, one cache line
+#define SCRATCH_ALIGNMENT 64
+
+// Per-thread scratch arena: a bump allocator holding the temporaries of the distance, normalization and selection hot paths
+// Each thread owns one arena, so drawing from it needs neither locks nor calls to the heap allocator. Blocks are released
+// in LIFO order, by going back to a previous mark
+
+// Space taken in the arena by a block of size bytes, used to compute the size to reserve
+static inline size_t scratch_block_size(size_t size){
+    return (size + SCRATCH_ALIGNMENT - 1) & ~((size_t) SCRATCH_ALIGNMENT - 1);
+}
+
+// Makes sure the arena of the calling thread holds at least size bytes
+// Only grows the arena (a heap allocation) when it is too small, and only when it is empty
+void scratch_reserve(size_t size);
+
+// Frees the arena of the calling thread (before the thread exits)
+void scratch_destroy(void);
+
+// Current position of the arena of the calling thread, to be given back to scratch_release
+size_t scratch_mark(void);
+
+// Releases every block drawn after mark (no effect when they were already released)
+void scratch_release(size_t mark);
+
+// Releases block and every block drawn after it
+void scratch_release_from(const void *block);
+
+// Draws an aligned block from the arena of the calling thread, exits when the reserved size is exceeded
+void *scratch_alloc(size_t size);
+
+#endif
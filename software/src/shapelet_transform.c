@@ -13,7 +13,33 @@
 
 
 #include "shapelet_transform.h"
+#include "fft.h"
+#include "scratch_arena.h"
+#include "thread_pool.h"
+#if defined(USE_SIMD) && !defined(USE_FIXED)
+#include "simd_kernels.h"
+#ifdef USE_EXPONENT_ABANDON
+#define SIMD_ABANDON_MODE SIMD_ABANDON_EXPONENT
+#else
+#define SIMD_ABANDON_MODE SIMD_ABANDON_EXACT
+#endif
+#endif
 #include <time.h>
+#include <omp.h>
+
+// Candidate early abandon on the F-statistic (USE_QUALITY_PRUNING), only where the distances of a candidate are computed one series at a time
+#if defined(USE_QUALITY_PRUNING) && !defined(USE_FIXED) && (!defined(USE_BATCHED_DISTANCES) || defined(USE_ABS))
+#define QUALITY_PRUNING
+#endif
+
+// Candidate by target evaluation in omp_shapelet_cached_selection (USE_TARGET_PARALLELISM, by tiles with USE_TILED_DISTANCES), 
+// batched distances are already parallel over targets
+#if (defined(USE_TARGET_PARALLELISM) || defined(USE_TILED_DISTANCES)) && (!defined(USE_BATCHED_DISTANCES) || defined(USE_FIXED) || defined(USE_ABS))
+#define TARGET_PARALLELISM
+#ifdef USE_TILED_DISTANCES
+#define TILED_DISTANCES
+#endif
+#endif
 
 // Allocates memory and checks for allocation error
 void *safe_alloc(size_t size)
@@ -29,37 +55,191 @@ void *safe_alloc(size_t size)
 
 
 // Returns a timeseries structure of a given class_id 
-Timeseries init_timeseries(numeric_type *values, uint8_t class, uint16_t length)
+Timeseries init_timeseries(numeric_type *values, uint8_t class, uint32_t length)
 {
     Timeseries ts;
     ts.class = class;
     ts.values = values;
     ts.length = length;
+    ts.prefix_sums = NULL;
+    ts.prefix_squares_sums = NULL;
     return ts;
 }
 
 
+// Builds the statistics index of a dataset: prefix sums and prefix sums of squares of each time series
+// The index is shared read-only by every thread of the search and by the transform
+size_t build_stats_index(Timeseries *T, uint16_t num_ts, size_t max_bytes){
+    size_t used_bytes = 0;
+    uint16_t num_indexed = 0;
+    
+    for (uint16_t i = 0; i < num_ts; i++){
+        const size_t series_bytes = 2 * (T[i].length + 1) * sizeof(double);
+        double sum = 0.0, squares_sum = 0.0;
+        
+        // Series beyond the cap are left without index, their window statistics are computed on demand
+        if (used_bytes + series_bytes > max_bytes)
+            continue;
+        
+        T[i].prefix_sums = safe_alloc((T[i].length + 1) * sizeof(*T[i].prefix_sums));
+        T[i].prefix_squares_sums = safe_alloc((T[i].length + 1) * sizeof(*T[i].prefix_squares_sums));
+        T[i].prefix_sums[0] = 0.0;
+        T[i].prefix_squares_sums[0] = 0.0;
+        for (uint32_t j = 0; j < T[i].length; j++){
+            sum += T[i].values[j];
+            squares_sum += (double) T[i].values[j] * T[i].values[j];
+            T[i].prefix_sums[j + 1] = sum;
+            T[i].prefix_squares_sums[j + 1] = squares_sum;
+        }
+        
+        used_bytes += series_bytes;
+        num_indexed++;
+    }
+    
+    printf("Statistics index: %u of %u time series, %zu bytes\n", num_indexed, num_ts, used_bytes);
+    
+    return used_bytes;
+}
+
+
+void free_stats_index(Timeseries *T, uint16_t num_ts){
+    for (uint16_t i = 0; i < num_ts; i++){
+        free(T[i].prefix_sums);
+        free(T[i].prefix_squares_sums);
+        T[i].prefix_sums = NULL;
+        T[i].prefix_squares_sums = NULL;
+    }
+}
+
+
 // Initializes a shapelet struct with given values
-Shapelet init_shapelet(Timeseries *time_series, uint16_t shapelet_position, uint16_t shapelet_len){
+Shapelet init_shapelet(Timeseries *time_series, uint32_t shapelet_position, uint32_t shapelet_len){
     Shapelet shapelet; 
     shapelet.length = shapelet_len;
     shapelet.quality = 0;
     shapelet.start_position = shapelet_position;
     shapelet.Ti = time_series;
+    shapelet.normalized_values = NULL;
+    shapelet.pivot_order = NULL;
+    shapelet.ordered_values = NULL;
     return shapelet;
 }
 
 
+// Scratch arena bytes taken by normalized_shapelet_ts_distance for a pivot of a given length against a time series of ts_length
+// Bound on every path together (windowed, reordered, dot product and MASS), so that any compile-time mode fits
+size_t distance_scratch_size(uint32_t length, uint32_t ts_length){
+    const uint32_t fft_length = next_power_of_two(ts_length);
+    const uint32_t num_blocks = (length + DOT_PRODUCT_BLOCK - 1) / DOT_PRODUCT_BLOCK;
+    size_t size = 0;
+    
+    size += scratch_block_size(length * sizeof(numeric_type));                            // target window copy
+    size += 2 * scratch_block_size(length * sizeof(numeric_type));                        // abandon order and ordered pivot
+    size += scratch_block_size(length * 2 * sizeof(double));                              // abandon order sorting entries
+    size += 2 * scratch_block_size((num_blocks + 1) * sizeof(double));                    // dot product pivot
+    size += scratch_block_size(ts_length * sizeof(numeric_type));                         // MASS distance profile
+    size += 4 * scratch_block_size(fft_length * sizeof(double));                          // MASS spectra
+    
+    return size;
+}
+
+
+// Scratch arena bytes taken by shapelet_normalize for a shapelet of a given length: the normalized values, and with 
+// USE_REORDERED_ABANDON their abandon order (sorted through a temporary block of entries)
+static size_t normalized_scratch_size(uint32_t length){
+    size_t size = scratch_block_size(length * sizeof(numeric_type));
+    
+    #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+    size += scratch_block_size(length * sizeof(uint32_t)) + scratch_block_size(length * sizeof(numeric_type));
+    size += scratch_block_size(length * 2 * sizeof(double));
+    #endif
+    return size;
+}
+
+
+#ifndef USE_FIXED
+// Scratch arena bytes taken by length_accumulators_init
+size_t length_accumulators_scratch_size(uint32_t pivot_ts_length, uint32_t target_ts_length){
+    return scratch_block_size((size_t) pivot_ts_length * target_ts_length * sizeof(double)) 
+         + 3 * (scratch_block_size(pivot_ts_length * sizeof(double)) + scratch_block_size(target_ts_length * sizeof(double)))
+         + 2 * (scratch_block_size(pivot_ts_length * sizeof(numeric_type)) + scratch_block_size(target_ts_length * sizeof(numeric_type)));
+}
+#endif
+
+
+// Scratch arena bytes needed by each thread of a selection function: the normalized candidate and its distances
+static size_t selection_scratch_size(uint32_t ts_length, uint16_t max){
+    size_t size = normalized_scratch_size(max) + distance_scratch_size(max, ts_length);
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    size += length_accumulators_scratch_size(ts_length, ts_length);
+    #endif
+    return size;
+}
+
+
+// Normalizes the shapelet values once and keeps them in the shapelet, to be reused by every shapelet_ts_distance call
+// With USE_REORDERED_ABANDON the abandon order is sorted here too, instead of at every distance
+// The values are drawn from the scratch arena of the calling thread (FREE WITH shapelet_free_normalized)
+void shapelet_normalize(Shapelet *shapelet){
+    numeric_type *normalized_values;
+    
+    // Standalone use: reserve for the distances against series as long as the one the shapelet comes from
+    if (scratch_mark() == 0)
+        scratch_reserve(normalized_scratch_size(shapelet->length) + distance_scratch_size(shapelet->length, shapelet->Ti->length));
+    normalized_values = scratch_alloc(shapelet->length * sizeof(*normalized_values));
+    normalized_copy(&shapelet->Ti->values[shapelet->start_position], shapelet->length, normalized_values);
+    
+    shapelet->normalized_values = normalized_values;
+    #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+    shapelet->pivot_order = scratch_alloc(shapelet->length * sizeof(*shapelet->pivot_order));
+    shapelet->ordered_values = scratch_alloc(shapelet->length * sizeof(*shapelet->ordered_values));
+    abandon_order(normalized_values, shapelet->length, shapelet->pivot_order, shapelet->ordered_values);
+    #endif
+}
+
+
+// Normalizes the values in place as shapelet_normalize does
+void normalize_values(numeric_type *values, uint32_t length){
+    #ifdef USE_ZSCORE
+    zscore_normalization(values, length);
+    #else
+    algebric_normalization(values, length);
+    #endif
+}
+
+
+// Copies length values into normalized_values and normalizes them as shapelet_normalize does
+void normalized_copy(const numeric_type *values, uint32_t length, numeric_type *normalized_values){
+    memcpy(normalized_values, values, length * sizeof(*normalized_values));
+    normalize_values(normalized_values, length);
+}
+
+
+// Releases the normalized values back to the scratch arena, together with anything drawn after them (the abandon order)
+void shapelet_free_normalized(Shapelet *shapelet){
+    if (shapelet->normalized_values != NULL)
+        scratch_release_from(shapelet->normalized_values);
+    shapelet->normalized_values = NULL;
+    shapelet->pivot_order = NULL;
+    shapelet->ordered_values = NULL;
+}
+
+
 // Generic vector normalization
-void algebric_normalization(numeric_type *values, uint16_t length){
+void algebric_normalization(numeric_type *values, uint32_t length){
     numeric_type squares_sum, absolute_value;
     
     squares_sum = 0;
     #ifndef USE_FIXED                                  // Floating point normalization
     // Compute absolute value
-    for (uint16_t i = 0; i < length; i++){
+    #ifdef USE_SIMD
+    squares_sum = simd_centered_squares_sum(values, length, 0);
+    #else
+    for (uint32_t i = 0; i < length; i++){
         squares_sum += pow(values[i], 2);
     }
+    #endif
     absolute_value = sqrt(squares_sum);
     
     // check for possible division by zero error
@@ -67,13 +247,17 @@ void algebric_normalization(numeric_type *values, uint16_t length){
         return;
 
     // Compute normalized vector values
-    for (uint16_t i = 0; i < length; i++)
+    #ifdef USE_SIMD
+    simd_standardize(values, length, 0, absolute_value);
+    #else
+    for (uint32_t i = 0; i < length; i++)
         values[i] = values[i] / absolute_value;
+    #endif
     
     
     #else                                           // Fixed point normalization
     // Compute absolute value
-    for (uint16_t i = 0; i < length; i++){
+    for (uint32_t i = 0; i < length; i++){
         squares_sum += fixedpt_pow2(values[i]);
     }
     absolute_value = fixedpt_sqrt(squares_sum);
@@ -82,7 +266,7 @@ void algebric_normalization(numeric_type *values, uint16_t length){
         return;
     
     // Compute normalized vector values
-    for (uint16_t i = 0; i < length; i++)
+    for (uint32_t i = 0; i < length; i++)
         values[i] = fixedpt_div(values[i], absolute_value);
     #endif
 }
@@ -92,16 +276,21 @@ void algebric_normalization(numeric_type *values, uint16_t length){
 // z score a.k.a. standardizing or normalizing (using sameple std_deviation)
 // each element of input values vector will be changed to:
 // values[i] = (values[i] - mean)/std_deviation
-void zscore_normalization(numeric_type *values, uint16_t length){
+void zscore_normalization(numeric_type *values, uint32_t length){
     numeric_type mean, std;
     #ifndef USE_FIXED 
     #ifdef USE_EXPECTED_VALUE
     // Computation of standard deviation by population formula (based on the properties of expected values)
     numeric_type s = 0, s2 = 0;
-    for (uint16_t i = 0; i < length; i++){
+    #ifdef USE_SIMD
+    s = simd_sum(values, length);
+    s2 = simd_centered_squares_sum(values, length, 0);
+    #else
+    for (uint32_t i = 0; i < length; i++){
         s += values[i];
         s2 += pow((double) values[i], 2);
     }
+    #endif
     
     mean = s / length;
     std = sqrt((s2 - pow((double) mean, 2)) / length);
@@ -111,17 +300,25 @@ void zscore_normalization(numeric_type *values, uint16_t length){
     numeric_type differrence_sum;
     
     // calculate arithmetic mean 
+    #ifdef USE_SIMD
+    mean = simd_sum(values, length) / length;
+    #else
     mean = 0;
-    for(uint16_t i=0; i < length; i++){
+    for(uint32_t i=0; i < length; i++){
         mean += values[i];
     }
     mean /= length;
+    #endif
 
     // calculate sum (xi - mean)^2
+    #ifdef USE_SIMD
+    differrence_sum = simd_centered_squares_sum(values, length, mean);
+    #else
     differrence_sum = 0;
-    for(uint16_t i=0; i < length; i++){
+    for(uint32_t i=0; i < length; i++){
         differrence_sum += pow(values[i] - mean, 2);
     }
+    #endif
     // divide sum by N - 1 
     differrence_sum /= (length - 1); // this is sample std deviation. Remove the -1 to make it population std_dev
     // take the sqrt
@@ -135,9 +332,13 @@ void zscore_normalization(numeric_type *values, uint16_t length){
     }
     else{
         // calculate the z score for each element
-        for(uint16_t i=0; i < length; i++){
+        #ifdef USE_SIMD
+        simd_standardize(values, length, mean, std);
+        #else
+        for(uint32_t i=0; i < length; i++){
             values[i] = (values[i] - mean) / std;
         }
+        #endif
     }
     
     #else
@@ -147,11 +348,37 @@ void zscore_normalization(numeric_type *values, uint16_t length){
 }
 
 
-numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, uint16_t length, numeric_type current_minimum_distance){
+#ifndef USE_FIXED
+// Early abandon check of the floating point distance loops
+// USE_EXPONENT_ABANDON abandons once the exponent of the partial sum exceeds the exponent of the minimum distance, as shapelet_distance.vhd does,
+// comparing the bit patterns as integers. It abandons no more than the exact compare, which is still applied to the complete distance
+static inline int partial_distance_abandoned(float total_distance, float current_minimum_distance){
+    #ifdef USE_EXPONENT_ABANDON
+    uint32_t total_bits, minimum_bits;
+    
+    memcpy(&total_bits, &total_distance, sizeof(total_bits));
+    memcpy(&minimum_bits, &current_minimum_distance, sizeof(minimum_bits));
+    return total_bits > (minimum_bits | 0x007FFFFF);
+    #else
+    return total_distance >= current_minimum_distance;
+    #endif
+}
+#endif
+
+
+numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, uint32_t length, numeric_type current_minimum_distance){
     numeric_type total_distance = 0.0;
     
     #ifndef USE_FIXED
-    for (uint16_t i = 0; i < length; i++){
+    #ifdef USE_SIMD
+    // Vector kernels selected at runtime, checking the early abandon once per block
+    #ifdef USE_ABS
+    total_distance = simd_absolute_distance(pivot_values, target_values, length, 0, 1, current_minimum_distance, SIMD_ABANDON_MODE);
+    #else
+    total_distance = simd_squared_distance(pivot_values, target_values, length, 0, 1, current_minimum_distance, SIMD_ABANDON_MODE);
+    #endif
+    #else
+    for (uint32_t i = 0; i < length; i++){
     #ifdef USE_ABS
         //uses the absolute value of differences instead of power. Experimental.
         total_distance += fabs((double) (pivot_values[i] - target_values[i]) );
@@ -160,15 +387,17 @@ numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target
         total_distance += pow((double)(pivot_values[i] - target_values[i]), 2.0);
     #endif
         //early abandon: in case partial distance sum result is bigger than the current minimun distance, we discard the calculation and return INFINITY
-        if(total_distance >= current_minimum_distance) return INFINITY;
+        if(partial_distance_abandoned(total_distance, current_minimum_distance)) return INFINITY;
     }
+    if(total_distance >= current_minimum_distance) return INFINITY;
+    #endif
     
     #else
     #ifdef USE_ABS
     printf("Error, euclidean distance using ABS isn't yet defined in fixed point representation");
     exit(-1);
     #else
-    for(uint16_t i = 0; i < length; i++){
+    for(uint32_t i = 0; i < length; i++){
         total_distance += fixedpt_pow2(pivot_values[i] - target_values[i]);
         if(total_distance >= current_minimum_distance) return MAX_FIXEDPT;
     }  
@@ -180,217 +409,1356 @@ numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target
 }
 
 
-// Distance from a shapelet to an entire time-series
-numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series){
-    numeric_type shapelet_distance, minimum_distance;
-    numeric_type *pivot_values, *target_values;                                              // we hold the shapelet values in a temporary vector so that we can manipulate and change this data without modifing the time series
-    const uint32_t num_shapelets = time_series->length - pivot_shapelet->length + 1;         // number of shapelets of length "shapelet_len" in time_series    uint8_t print_flag;
+#ifndef USE_FIXED
+// Normalization statistics of a window computed in O(1) from its sum and sum of squares
+// Each normalized element of the window is given by (value - offset) * scale, following the same formulas as the normalization functions
+void window_normalization_stats(double sum, double squares_sum, uint32_t length, numeric_type *offset, numeric_type *scale){
+    #ifdef USE_ZSCORE
+    numeric_type mean, std;
     
-    #ifndef USE_FIXED
-    minimum_distance = INFINITY;
+    mean = sum / length;
+    #ifdef USE_EXPECTED_VALUE
+    // Population formula, as in zscore_normalization
+    std = sqrt((squares_sum - pow((double) mean, 2)) / length);
     #else
-    minimum_distance = MAX_FIXEDPT;
+    // Sample formula, as in zscore_normalization
+    // Running sums carry rounding residue, therefore windows with negligible variance are treated as straight lines
+    double centered_squares_sum = squares_sum - sum * sum / length;
+    if (centered_squares_sum <= squares_sum * SLIDING_STATS_EPSILON)
+        centered_squares_sum = 0.0;
+    std = sqrt(centered_squares_sum / (length - 1));
     #endif
     
-    // Normalize pivot 
-    pivot_values = safe_alloc(pivot_shapelet->length * sizeof(*pivot_values));
-    memcpy(pivot_values, &pivot_shapelet->Ti->values[pivot_shapelet->start_position], pivot_shapelet->length * sizeof(*pivot_values));
+    // Straight lines are normalized to zero
+    if (std == 0){
+        *offset = 0;
+        *scale = 0;
+    }
+    else{
+        *offset = mean;
+        *scale = 1.0 / std;
+    }
     
-    #ifdef USE_ZSCORE
-    zscore_normalization(pivot_values, pivot_shapelet->length);
     #else
-    algebric_normalization(pivot_values, pivot_shapelet->length);
+    numeric_type absolute_value = sqrt(squares_sum);
+    
+    // Null vectors are left untouched by algebric_normalization
+    *offset = 0;
+    *scale = (absolute_value == 0) ? 1 : 1.0 / absolute_value;
     #endif
-        
-    // Allocate memory for target values 
-    // Pivot shapelet and ts shapelets must always have equal length
-    target_values = safe_alloc(pivot_shapelet->length * sizeof(*target_values));
+}
 
-    // Loops over shapelets in the time-series
-    for(uint32_t i=0; i<num_shapelets; i++){
-        // initialize normalized values of time series shapelet starting at i
-        memcpy(target_values, &time_series->values[i], pivot_shapelet->length * sizeof(*target_values));
-        
-        // Normalize target shapelet values
-        #ifdef USE_ZSCORE
-        zscore_normalization(target_values, pivot_shapelet->length);
-        #else
-        algebric_normalization(target_values, pivot_shapelet->length);
-        #endif
-        
-        // Compute shapelet-shapelet distance
-        shapelet_distance = euclidean_distance(pivot_values, target_values, pivot_shapelet->length, minimum_distance);
-        
-        // Keep the minimum distance between the pivot shapelet and all the time-series shapelets
-        if (shapelet_distance < minimum_distance){
-            minimum_distance = shapelet_distance;
+
+// Sum and sum of squares of the window of a given length starting at i, read from the statistics index when the series has one
+// Otherwise the running sums are slid from the window at i - 1, therefore the windows must be visited in order starting at 0
+void window_sums(const Timeseries *time_series, uint32_t i, uint32_t length, double *window_sum, double *window_squares_sum){
+    const numeric_type *ts_values = time_series->values;
+    
+    if (time_series->prefix_sums != NULL){
+        *window_sum = time_series->prefix_sums[i + length] - time_series->prefix_sums[i];
+        *window_squares_sum = time_series->prefix_squares_sums[i + length] - time_series->prefix_squares_sums[i];
+    }
+    else if (i == 0){
+        *window_sum = 0.0;
+        *window_squares_sum = 0.0;
+        for (uint32_t k = 0; k < length; k++){
+            *window_sum += ts_values[k];
+            *window_squares_sum += (double) ts_values[k] * ts_values[k];
         }
-        
     }
+    else{
+        // Slide the window: remove the leaving element and add the entering one
+        const double leaving = ts_values[i - 1], entering = ts_values[i + length - 1];
+        *window_sum += entering - leaving;
+        *window_squares_sum += entering * entering - leaving * leaving;
+    }
+}
 
-    free(pivot_values);
-    free(target_values);
 
-    return minimum_distance;
+// Euclidean distance between a normalized pivot and a raw target window, normalized on the fly with its offset and scale
+numeric_type window_euclidean_distance(numeric_type *pivot_values, const numeric_type *target_values, uint32_t length, numeric_type offset, numeric_type scale, numeric_type current_minimum_distance){
+    #ifdef USE_SIMD
+    #ifdef USE_ABS
+    return simd_absolute_distance(pivot_values, target_values, length, offset, scale, current_minimum_distance, SIMD_ABANDON_MODE);
+    #else
+    return simd_squared_distance(pivot_values, target_values, length, offset, scale, current_minimum_distance, SIMD_ABANDON_MODE);
+    #endif
+    #else
+    numeric_type difference, total_distance = 0.0;
+    
+    for (uint32_t i = 0; i < length; i++){
+        difference = pivot_values[i] - (target_values[i] - offset) * scale;
+    #ifdef USE_ABS
+        total_distance += fabs(difference);
+    #else
+        total_distance += difference * difference;
+    #endif
+        // Early abandon, as in euclidean_distance
+        if(partial_distance_abandoned(total_distance, current_minimum_distance)) return INFINITY;
+    }
+    
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+    #endif
 }
 
 
-// F-Statistic based on distance measures and associated binary classes
-numeric_type bin_f_statistic(numeric_type *measured_distances, Timeseries *ts_set, uint16_t num_ts){
-    numeric_type f_stat;
-    numeric_type total_dists_sum = 0.0, class_zero_sum = 0.0, class_one_sum = 0.0;
-    numeric_type total_dists_avg, class_zero_avg, class_one_avg;
-    numeric_type numerator_sum = 0.0, denominator_sum = 0.0;
-    uint16_t class_zero_ts_num = 0, class_one_ts_num = 0;
+// Pair used to sort the pivot indices by magnitude
+typedef struct{
+    numeric_type magnitude;
+    uint32_t index;
+} Abandon_order_entry;
+
+static int compare_abandon_order(const void *entry_1, const void *entry_2){
+    const numeric_type magnitude_1 = ((const Abandon_order_entry *) entry_1)->magnitude;
+    const numeric_type magnitude_2 = ((const Abandon_order_entry *) entry_2)->magnitude;
     
-    if(num_ts <= 2)
-    {
-        printf("Number of time series must be greater than 2!");
-        exit(-1);
-    }
+    // Decreasing magnitude, ties broken by index so that the order is deterministic
+    if (magnitude_1 != magnitude_2)
+        return (magnitude_1 < magnitude_2) ? 1 : -1;
+    return (((const Abandon_order_entry *) entry_1)->index > ((const Abandon_order_entry *) entry_2)->index) ? 1 : -1;
+}
 
-    // Count the number of time series in each class and compute the sum of distaces for each class
-    for(uint16_t i = 0; i < num_ts; i++){
-        if (ts_set[i].class == 0){
-            class_zero_sum += measured_distances[i];
-            class_zero_ts_num++;
-        }
-        else if (ts_set[i].class == 1){
-            class_one_sum += measured_distances[i];
-            class_one_ts_num++;
-        }
-        else{
-            printf("Class is not binary");
-            exit(-1);
-        }
-    }
 
-    #ifndef USE_FIXED
-    // Calculate average values for each class and for the entire distances array
-    class_zero_avg = class_zero_sum/class_zero_ts_num;
-    class_one_avg = class_one_sum/class_one_ts_num;
-    total_dists_sum = class_zero_sum + class_one_sum;
-    total_dists_avg = total_dists_sum/num_ts;
+// Indices of the normalized pivot sorted by decreasing |value| (UCR suite ordering), and the pivot permuted in that order
+// Points far from the mean contribute the most to the distance against most windows, so visiting them first abandons sooner
+void abandon_order(const numeric_type *normalized_values, uint32_t length, uint32_t *order, numeric_type *ordered_values){
+    Abandon_order_entry *entries = scratch_alloc(length * sizeof(*entries));
     
-    // Calculate the sum in f-stat formula numerator
-    numerator_sum = pow(class_zero_avg - total_dists_avg, 2) + pow(class_one_avg - total_dists_avg, 2);
-    // Calculate the sums in f-stat formula denominator
-    for(uint16_t i = 0; i < num_ts; i++){
-        if (ts_set[i].class == 0){
-            denominator_sum += pow(measured_distances[i] - class_zero_avg, 2);
-        }
-        else if (ts_set[i].class == 1){
-            denominator_sum += pow(measured_distances[i] - class_one_avg, 2);
-        }
-        else{
-            printf("Class is not binary");
-            exit(-1);
-        }
+    for (uint32_t i = 0; i < length; i++){
+        entries[i].magnitude = fabs(normalized_values[i]);
+        entries[i].index = i;
     }
-    if(denominator_sum == 0)
-    {
-        printf("Error calculating f statistic! Division by zero\n");
-        exit(-1);
+    qsort(entries, length, sizeof(*entries), compare_abandon_order);
+    
+    for (uint32_t i = 0; i < length; i++){
+        order[i] = entries[i].index;
+        ordered_values[i] = normalized_values[entries[i].index];
     }
-    f_stat = numerator_sum / (denominator_sum/(num_ts-2));
+    scratch_release_from(entries);
+}
+
+
+// Same as window_euclidean_distance, visiting the target window in the order given by abandon_order
+numeric_type ordered_euclidean_distance(const numeric_type *ordered_pivot_values, const numeric_type *target_values, const uint32_t *order, uint32_t length, numeric_type offset, numeric_type scale, numeric_type current_minimum_distance){
+    #ifdef USE_SIMD
+    #ifdef USE_ABS
+    return simd_ordered_absolute_distance(ordered_pivot_values, target_values, order, length, offset, scale, current_minimum_distance, SIMD_ABANDON_MODE);
     #else
-    // Calculate average values for each class and for the entire distances array
-    class_zero_avg = fixedpt_div(class_zero_sum, fixedpt_fromint(class_zero_ts_num));
-    class_one_avg = fixedpt_div(class_one_sum, fixedpt_fromint(class_one_ts_num));
-    total_dists_sum = class_zero_sum + class_one_sum;
-    total_dists_avg = fixedpt_div(total_dists_sum, fixedpt_fromint(num_ts));
-    // Calculate the sum in f-stat formula numerator
-    numerator_sum = fixedpt_pow2(class_zero_avg - total_dists_avg) + fixedpt_pow2(class_one_avg - total_dists_avg);
-    // Calculate the sums in f-stat formula denominator
-    for(uint16_t i = 0; i < num_ts; i++){
-        if(ts_set[i].class == 0){
-            temp_difference = measured_distances[i] - class_zero_avg;
-        }
-        else if (ts_set[i].class == 1){
-            temp_difference = measured_distances[i] - class_one_avg;
-        }
-        else{
-            printf("Class is not binary");
-            exit(-1);
-        }
-        denominator_sum += fixedpt_pow2(temp_difference);
-        
-    }
-    if(denominator_sum == 0)
-    {
-        printf("Error calculating f statistic! Division by zero\n");
-        exit(-1);
-    }
-    
-    f_stat = fixedpt_div(numerator_sum, fixedpt_div(denominator_sum, (fixedpt_fromint(num_ts) - FIXEDPT_TWO)));
+    return simd_ordered_squared_distance(ordered_pivot_values, target_values, order, length, offset, scale, current_minimum_distance, SIMD_ABANDON_MODE);
+    #endif
+    #else
+    numeric_type difference, total_distance = 0.0;
     
+    for (uint32_t i = 0; i < length; i++){
+        difference = ordered_pivot_values[i] - (target_values[order[i]] - offset) * scale;
+    #ifdef USE_ABS
+        total_distance += fabs(difference);
+    #else
+        total_distance += difference * difference;
     #endif
+        if(partial_distance_abandoned(total_distance, current_minimum_distance)) return INFINITY;
+    }
     
-    return f_stat;
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+    #endif
 }
 
 
-// Compare shapelets quality measures for sorting with qsort()
-static int compare_shapelets(const void *shapelet_1, const void *shapelet_2){
-    const numeric_type shapelet_1_quality = ((const Shapelet *)shapelet_1)->quality;
-    const numeric_type shapelet_2_quality = ((const Shapelet *)shapelet_2)->quality;
+// Precomputes the normalized pivot quantities used by dot_product_distance
+void dot_product_pivot_init(Dot_product_pivot *pivot, numeric_type *normalized_values, uint32_t length){
+    const uint32_t num_blocks = (length + DOT_PRODUCT_BLOCK - 1) / DOT_PRODUCT_BLOCK;
+    double suffix_sum = 0.0, suffix_squares_sum = 0.0;
     
-    if (shapelet_1_quality < shapelet_2_quality)
-    {
-        return 1;
-    }
-    else if (shapelet_1_quality > shapelet_2_quality)
-    {
-        return -1;
-    }
-    else
-    {
-        return 0;
+    pivot->values = normalized_values;
+    pivot->length = length;
+    pivot->suffix_sums = scratch_alloc((num_blocks + 1) * sizeof(*pivot->suffix_sums));
+    pivot->suffix_norms = scratch_alloc((num_blocks + 1) * sizeof(*pivot->suffix_norms));
+    
+    // Suffix sums are kept only at block boundaries, where the early abandon bound is checked
+    pivot->suffix_sums[num_blocks] = 0.0;
+    pivot->suffix_norms[num_blocks] = 0.0;
+    for (int64_t i = (int64_t) length - 1; i >= 0; i--){
+        suffix_sum += normalized_values[i];
+        suffix_squares_sum += (double) normalized_values[i] * normalized_values[i];
+        if (i % DOT_PRODUCT_BLOCK == 0){
+            pivot->suffix_sums[i / DOT_PRODUCT_BLOCK] = suffix_sum;
+            pivot->suffix_norms[i / DOT_PRODUCT_BLOCK] = sqrt(suffix_squares_sum);
+        }
     }
+    pivot->sum = suffix_sum;
+    pivot->squares_sum = suffix_squares_sum;
 }
 
 
-// SHAPELET CACHED SELECTION (from algorithm 3 in "Classification of time series by shapelet transformation", Hills et al., 2013)
-// Given a set T of time series attatched to labels, extract shapelets exhaustively from min to max lengths, keeping only the k best shapelets according to some criteria 
-// (DESTROY ALL k RETURNED SHAPELETS AFTER USAGE)
-Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k){
-    uint16_t shapelets_index;
-    uint32_t num_shapelets; //number of shapelets of lenght l 
-    uint32_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
-    uint32_t num_merged_shapelets; //total number of shapelets to be merged after removing self similars
-    Shapelet *k_shapelets, *ts_shapelets;
-    Shapelet shapelet_candidate;
-    // alocates space for the distance from each shapelet to the target TS. This array is reused for each candidate shapelet
-    numeric_type *shapelet_distances = safe_alloc(num_ts * sizeof(*shapelet_distances));
+void dot_product_pivot_free(Dot_product_pivot *pivot){
+    scratch_release_from(pivot->suffix_sums);
+}
 
-    //checks to assert if the parameters are valid
-    if (min > max){
-        printf("Min greater than max");
-        exit(-1);
-    }
 
-    if(num_ts <= 2)
-    {
-        printf("Number of time series must be greater than 2");
-        exit(-1);
-    }
+// Squared euclidean distance between a normalized pivot and a window normalized as (t - offset) * scale, given dot(p, t) and sum((t - offset)^2)
+static inline double dot_to_distance(const Dot_product_pivot *pivot, double dot, numeric_type offset, numeric_type scale, double centered_squares_sum){
+    double distance = pivot->squares_sum + scale * scale * centered_squares_sum - 2.0 * scale * (dot - offset * pivot->sum);
+    
+    // Identical windows may lead to tiny negative distances due to rounding
+    return (distance < 0.0) ? 0.0 : distance;
+}
 
-    k_shapelets = safe_alloc(k*sizeof(*k_shapelets));
-    if(memset(k_shapelets, 0, k * sizeof(*k_shapelets)) == NULL)
-    {
-        printf("Error on memset k_shapelets\n");
-        exit(-1);
-    }
 
-    // total number of shapelets in each T[i] 
-    total_num_shapelets = (min-max-1) * (max + min - 2*T->length - 2)/(2);
-    printf("Total number of shapelets for each time-series: %u\n", total_num_shapelets);
+// Squared euclidean distance between a normalized pivot (p) and a raw target window (t), using its dot product
+// With t normalized as (t - offset) * scale:
+//   distance = sum(p^2) + sum(t_norm^2) - 2 * scale * (dot(p, t) - offset * sum(p))
+// so the inner loop is a single multiply-add stream. The early abandon threshold is translated into a minimum dot product,
+// and after each block the remaining terms are bounded by Cauchy-Schwarz to abandon the window as soon as it cannot be reached
+numeric_type dot_product_distance(const Dot_product_pivot *pivot, const numeric_type *target_values, double window_sum, double window_squares_sum, numeric_type current_minimum_distance){
+    const uint32_t length = pivot->length;
+    numeric_type offset, scale;
+    double centered_squares_sum, target_norm, dot_threshold, dot = 0.0;
+    double distance;
     
-    // For each time-series T[i] in T
+    window_normalization_stats(window_sum, window_squares_sum, length, &offset, &scale);
+    
+    // Straight lines are normalized to zero, the distance is just the pivot energy
+    if (scale == 0){
+        distance = pivot->squares_sum;
+        return (distance >= current_minimum_distance) ? INFINITY : distance;
+    }
+    
+    // sum((t - offset)^2), from the window running sums
+    centered_squares_sum = window_squares_sum - 2.0 * offset * window_sum + (double) length * offset * offset;
+    if (centered_squares_sum < 0.0)
+        centered_squares_sum = 0.0;
+    target_norm = sqrt(centered_squares_sum);
+    
+    // The window beats current_minimum_distance only if dot(p, t) > dot_threshold
+    dot_threshold = (pivot->squares_sum + scale * scale * centered_squares_sum - current_minimum_distance) / (2.0 * scale) + offset * pivot->sum;
+    
+    for (uint32_t block = 0, i = 0; i < length; block++){
+        const uint32_t block_end = (i + DOT_PRODUCT_BLOCK < length) ? i + DOT_PRODUCT_BLOCK : length;
+        for (; i < block_end; i++){
+            dot += (double) pivot->values[i] * target_values[i];
+        }
+        // Early abandon: upper bound of the remaining dot product terms
+        //   dot(p_rem, t_rem) = dot(p_rem, t_rem - offset) + offset * sum(p_rem) <= |p_rem| * |t - offset| + offset * sum(p_rem)
+        if (dot + pivot->suffix_norms[block + 1] * target_norm + offset * pivot->suffix_sums[block + 1] <= dot_threshold)
+            return INFINITY;
+    }
+    
+    distance = dot_to_distance(pivot, dot, offset, scale, centered_squares_sum);
+    
+    return (distance >= current_minimum_distance) ? INFINITY : distance;
+}
+
+
+// Returns 1 when the FFT-based distance profile is expected to be cheaper than the windowed loop
+// The windowed loop costs up to (n - l + 1) * l multiply-adds, while MASS costs two FFTs of the padded series length
+uint8_t mass_is_cheaper(uint32_t length, uint32_t ts_length){
+    const uint32_t fft_length = next_power_of_two(ts_length);
+    const double windowed_cost = (double) (ts_length - length + 1) * length;
+    const double mass_cost = MASS_COST_FACTOR * fft_length * log2(fft_length);
+    
+    return windowed_cost > mass_cost;
+}
+
+
+// Distance profile of a normalized pivot against every window of a time series in O(n log n) (MASS, Mueen et al.)
+// The dot products of all the windows are a single cross-correlation, computed with FFTs. The real series and the reversed 
+// pivot are packed as the real and imaginary parts of one complex vector, so that a single forward transform is needed
+void mass_distance_profile(const Dot_product_pivot *pivot, const Timeseries *time_series, numeric_type *distance_profile){
+    const uint32_t length = pivot->length, ts_length = time_series->length;
+    const uint32_t num_windows = ts_length - length + 1;
+    const uint32_t fft_length = next_power_of_two(ts_length);
+    const numeric_type *ts_values = time_series->values;
+    double *packed_real, *packed_imag, *product_real, *product_imag;
+    double window_sum, window_squares_sum, centered_squares_sum;
+    numeric_type offset, scale;
+    
+    packed_real = scratch_alloc(fft_length * sizeof(*packed_real));
+    packed_imag = scratch_alloc(fft_length * sizeof(*packed_imag));
+    product_real = scratch_alloc(fft_length * sizeof(*product_real));
+    product_imag = scratch_alloc(fft_length * sizeof(*product_imag));
+    
+    // Zero padding up to a power of two is enough: the circular correlation only wraps around outside the valid windows
+    memset(packed_real, 0, fft_length * sizeof(*packed_real));
+    memset(packed_imag, 0, fft_length * sizeof(*packed_imag));
+    for (uint32_t i = 0; i < ts_length; i++)
+        packed_real[i] = ts_values[i];
+    for (uint32_t i = 0; i < length; i++)
+        packed_imag[i] = pivot->values[length - 1 - i];
+    
+    fft(packed_real, packed_imag, fft_length, 0);
+    
+    // Unpack both spectra (Z = S + iP, S[k] = (Z[k] + conj(Z[N-k]))/2, P[k] = (Z[k] - conj(Z[N-k]))/2i) and multiply them
+    for (uint32_t k = 0; k < fft_length; k++){
+        const uint32_t mirror = (fft_length - k) & (fft_length - 1);
+        const double series_real = (packed_real[k] + packed_real[mirror]) / 2.0;
+        const double series_imag = (packed_imag[k] - packed_imag[mirror]) / 2.0;
+        const double pivot_real = (packed_imag[k] + packed_imag[mirror]) / 2.0;
+        const double pivot_imag = (packed_real[mirror] - packed_real[k]) / 2.0;
+        product_real[k] = series_real * pivot_real - series_imag * pivot_imag;
+        product_imag[k] = series_real * pivot_imag + series_imag * pivot_real;
+    }
+    
+    fft(product_real, product_imag, fft_length, 1);
+    
+    // The dot product of the window starting at i lies at i + length - 1 of the correlation
+    for (uint32_t i = 0; i < num_windows; i++){
+        window_sums(time_series, i, length, &window_sum, &window_squares_sum);
+        window_normalization_stats(window_sum, window_squares_sum, length, &offset, &scale);
+        centered_squares_sum = window_squares_sum - 2.0 * offset * window_sum + (double) length * offset * offset;
+        if (centered_squares_sum < 0.0)
+            centered_squares_sum = 0.0;
+        
+        distance_profile[i] = dot_to_distance(pivot, product_real[i + length - 1] / fft_length, offset, scale, centered_squares_sum);
+    }
+    
+    scratch_release_from(packed_real);
+}
+
+
+// Squared euclidean distance between two raw windows p and t normalized as (p - p_offset) * p_scale and (t - t_offset) * t_scale,
+// from their raw dot product, window sums and centered sums of squares sum((x - x_offset)^2)
+static inline double raw_dot_to_distance(double dot, uint32_t length, 
+                                         double pivot_sum, numeric_type pivot_offset, numeric_type pivot_scale, double pivot_centered,
+                                         double target_sum, numeric_type target_offset, numeric_type target_scale, double target_centered){
+    const double normalized_dot = (double) pivot_scale * target_scale * (dot - pivot_offset * target_sum - target_offset * pivot_sum + (double) length * pivot_offset * target_offset);
+    const double distance = (double) pivot_scale * pivot_scale * pivot_centered + (double) target_scale * target_scale * target_centered - 2.0 * normalized_dot;
+    
+    // Identical windows may lead to tiny negative distances due to rounding
+    return (distance < 0.0) ? 0.0 : distance;
+}
+
+
+// Draws the accumulators of two time series from the scratch arena (see length_accumulators_scratch_size) and computes the dot products of all (position, window) pairs at the initial length
+// The dot product of the pivot window p and the target window w is updated in O(1) from the one of (p - 1, w - 1), 
+// so each diagonal of the position x window matrix costs a single O(l) initialization (STOMP, Zhu et al.)
+void length_accumulators_init(Length_accumulators *acc, const Timeseries *pivot_ts, const Timeseries *target_ts, uint32_t length){
+    const numeric_type *pivot_values = pivot_ts->values, *target_values = target_ts->values;
+    const uint32_t num_positions = pivot_ts->length - length + 1;
+    const uint32_t num_windows = target_ts->length - length + 1;
+    
+    acc->pivot_ts = pivot_ts;
+    acc->target_ts = target_ts;
+    acc->length = length;
+    acc->dots = scratch_alloc((size_t) pivot_ts->length * target_ts->length * sizeof(*acc->dots));
+    acc->pivot_sums = scratch_alloc(pivot_ts->length * sizeof(*acc->pivot_sums));
+    acc->pivot_squares_sums = scratch_alloc(pivot_ts->length * sizeof(*acc->pivot_squares_sums));
+    acc->target_sums = scratch_alloc(target_ts->length * sizeof(*acc->target_sums));
+    acc->target_squares_sums = scratch_alloc(target_ts->length * sizeof(*acc->target_squares_sums));
+    acc->pivot_offsets = scratch_alloc(pivot_ts->length * sizeof(*acc->pivot_offsets));
+    acc->pivot_scales = scratch_alloc(pivot_ts->length * sizeof(*acc->pivot_scales));
+    acc->pivot_centered = scratch_alloc(pivot_ts->length * sizeof(*acc->pivot_centered));
+    acc->target_offsets = scratch_alloc(target_ts->length * sizeof(*acc->target_offsets));
+    acc->target_scales = scratch_alloc(target_ts->length * sizeof(*acc->target_scales));
+    acc->target_centered = scratch_alloc(target_ts->length * sizeof(*acc->target_centered));
+    
+    for (uint32_t position = 0; position < num_positions; position++){
+        acc->pivot_sums[position] = 0.0;
+        acc->pivot_squares_sums[position] = 0.0;
+        for (uint32_t i = 0; i < length; i++){
+            acc->pivot_sums[position] += pivot_values[position + i];
+            acc->pivot_squares_sums[position] += (double) pivot_values[position + i] * pivot_values[position + i];
+        }
+    }
+    for (uint32_t window = 0; window < num_windows; window++){
+        acc->target_sums[window] = 0.0;
+        acc->target_squares_sums[window] = 0.0;
+        for (uint32_t i = 0; i < length; i++){
+            acc->target_sums[window] += target_values[window + i];
+            acc->target_squares_sums[window] += (double) target_values[window + i] * target_values[window + i];
+        }
+    }
+    
+    for (int64_t d = 1 - (int64_t) num_positions; d < (int64_t) num_windows; d++){
+        uint32_t position = (d < 0) ? (uint32_t) -d : 0;
+        uint32_t window = (d < 0) ? 0 : (uint32_t) d;
+        double dot = 0.0;
+        
+        for (uint32_t i = 0; i < length; i++)
+            dot += (double) pivot_values[position + i] * target_values[window + i];
+        
+        for (; position < num_positions && window < num_windows; position++, window++){
+            acc->dots[(size_t) position * target_ts->length + window] = dot;
+            if (position + 1 < num_positions && window + 1 < num_windows)
+                dot += (double) pivot_values[position + length] * target_values[window + length] - (double) pivot_values[position] * target_values[window];
+        }
+    }
+}
+
+
+void length_accumulators_free(Length_accumulators *acc){
+    scratch_release_from(acc->dots);
+}
+
+
+void length_accumulators_grow(Length_accumulators *acc){
+    const numeric_type *pivot_values = acc->pivot_ts->values, *target_values = acc->target_ts->values;
+    const uint32_t length = acc->length;
+    const uint32_t stride = acc->target_ts->length;
+    const uint32_t num_positions = acc->pivot_ts->length - length;        // number of positions at length + 1
+    const uint32_t num_windows = acc->target_ts->length - length;
+    
+    for (uint32_t position = 0; position < num_positions; position++){
+        const double entering = pivot_values[position + length];
+        double *dots = &acc->dots[(size_t) position * stride];
+        
+        for (uint32_t window = 0; window < num_windows; window++)
+            dots[window] += entering * target_values[window + length];
+        
+        acc->pivot_sums[position] += entering;
+        acc->pivot_squares_sums[position] += entering * entering;
+    }
+    for (uint32_t window = 0; window < num_windows; window++){
+        const double entering = target_values[window + length];
+        acc->target_sums[window] += entering;
+        acc->target_squares_sums[window] += entering * entering;
+    }
+    
+    acc->length = length + 1;
+}
+
+
+// Minimum distance of every pivot position against all the target windows, at the current length of the accumulators
+void length_accumulators_distances(Length_accumulators *acc, numeric_type *minimum_distances){
+    const uint32_t length = acc->length;
+    const uint32_t stride = acc->target_ts->length;
+    const uint32_t num_positions = acc->pivot_ts->length - length + 1;
+    const uint32_t num_windows = acc->target_ts->length - length + 1;
+    
+    // Window normalization statistics at the current length
+    for (uint32_t position = 0; position < num_positions; position++){
+        window_normalization_stats(acc->pivot_sums[position], acc->pivot_squares_sums[position], length, &acc->pivot_offsets[position], &acc->pivot_scales[position]);
+        acc->pivot_centered[position] = acc->pivot_squares_sums[position] - 2.0 * acc->pivot_offsets[position] * acc->pivot_sums[position] + (double) length * acc->pivot_offsets[position] * acc->pivot_offsets[position];
+    }
+    for (uint32_t window = 0; window < num_windows; window++){
+        window_normalization_stats(acc->target_sums[window], acc->target_squares_sums[window], length, &acc->target_offsets[window], &acc->target_scales[window]);
+        acc->target_centered[window] = acc->target_squares_sums[window] - 2.0 * acc->target_offsets[window] * acc->target_sums[window] + (double) length * acc->target_offsets[window] * acc->target_offsets[window];
+    }
+    
+    for (uint32_t position = 0; position < num_positions; position++){
+        const double *dots = &acc->dots[(size_t) position * stride];
+        double minimum_distance = INFINITY;
+        
+        for (uint32_t window = 0; window < num_windows; window++){
+            const double distance = raw_dot_to_distance(dots[window], length,
+                                                        acc->pivot_sums[position], acc->pivot_offsets[position], acc->pivot_scales[position], acc->pivot_centered[position],
+                                                        acc->target_sums[window], acc->target_offsets[window], acc->target_scales[window], acc->target_centered[window]);
+            if (distance < minimum_distance)
+                minimum_distance = distance;
+        }
+        minimum_distances[position] = minimum_distance;
+    }
+}
+
+
+// [HARDWARE-friendly, reducing memory transfer] Minimum distances from all the "shapelet_len"-sized shapelets in a time series to another time series
+// Single length evaluation of the accumulators
+void length_wise_distances(const Timeseries *pivot_ts, const Timeseries *target_ts, uint32_t shapelet_len, numeric_type *minimum_distances){
+    Length_accumulators acc;
+    
+    // Standalone call: the arena is sized for this pair (a no-op once it is large enough)
+    if (scratch_mark() == 0)
+        scratch_reserve(length_accumulators_scratch_size(pivot_ts->length, target_ts->length));
+    length_accumulators_init(&acc, pivot_ts, target_ts, shapelet_len);
+    length_accumulators_distances(&acc, minimum_distances);
+    length_accumulators_free(&acc);
+}
+#endif
+
+
+// k-th window of the scan starting at first_window and sweeping outward: first_window, first_window - 1, first_window + 1, 
+// first_window - 2, ..., then the remaining windows of the longer side
+static inline uint32_t outward_window(uint32_t k, uint32_t first_window, uint32_t num_windows){
+    const uint32_t left = first_window, right = num_windows - 1 - first_window;
+    const uint32_t both_sides = (left < right) ? left : right;
+    uint32_t offset;
+    
+    if (k <= 2 * both_sides){
+        offset = (k + 1) / 2;
+        return (k % 2 == 1) ? first_window - offset : first_window + offset;
+    }
+    offset = k - both_sides;
+    return (left > right) ? first_window - offset : first_window + offset;
+}
+
+
+// Distance from an already normalized pivot to an entire time-series (pivot_values are left untouched)
+// Temporaries are drawn from the scratch arena of the calling thread (see distance_scratch_size)
+numeric_type normalized_shapelet_ts_distance(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series){
+    uint32_t best_window = 0;
+    
+    return warm_normalized_shapelet_ts_distance(pivot_values, length, time_series, &best_window);
+}
+
+
+// The minimum distance found at the first window bounds the early abandon of all the others, so starting near the best 
+// match makes most of them abandon early. Every window is still visited, and the minimum is the same from any start
+numeric_type warm_normalized_shapelet_ts_distance(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series, uint32_t *best_window){
+    return normalized_shapelet_ts_distance_profile(pivot_values, length, time_series, best_window, NULL);
+}
+
+
+numeric_type normalized_shapelet_ts_distance_profile(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series, 
+                                                     uint32_t *best_window, numeric_type *distance_profile){
+    return ordered_shapelet_ts_distance_profile(pivot_values, NULL, NULL, length, time_series, best_window, distance_profile);
+}
+
+
+// Without a profile, each window distance is abandoned once it exceeds the minimum so far, otherwise it is computed in full
+numeric_type ordered_shapelet_ts_distance_profile(numeric_type *pivot_values, const uint32_t *pivot_order, const numeric_type *ordered_pivot_values, 
+                                                  uint32_t length, const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile){
+    numeric_type shapelet_distance, minimum_distance, abandon_distance;
+    const uint32_t num_shapelets = time_series->length - length + 1;                         // number of shapelets of length "shapelet_len" in time_series
+    const uint32_t first_window = (*best_window < num_shapelets) ? *best_window : num_shapelets - 1;
+    const size_t scratch_start = scratch_mark();
+    uint32_t i;
+    
+    #ifndef USE_FIXED
+    minimum_distance = INFINITY;
+    #else
+    minimum_distance = MAX_FIXEDPT;
+    #endif
+    abandon_distance = minimum_distance;
+    *best_window = first_window;
+    
+    #if defined(USE_MASS) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // Long time series: the whole distance profile is computed at once with FFTs
+    if (mass_is_cheaper(length, time_series->length)){
+        Dot_product_pivot mass_pivot;
+        
+        if (distance_profile == NULL)
+            distance_profile = scratch_alloc(num_shapelets * sizeof(*distance_profile));
+        dot_product_pivot_init(&mass_pivot, pivot_values, length);
+        mass_distance_profile(&mass_pivot, time_series, distance_profile);
+        for (i = 0; i < num_shapelets; i++){
+            if (distance_profile[i] < minimum_distance){
+                minimum_distance = distance_profile[i];
+                *best_window = i;
+            }
+        }
+        
+        dot_product_pivot_free(&mass_pivot);
+        scratch_release(scratch_start);
+        return minimum_distance;
+    }
+    #endif
+    
+    #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+    // Every window is visited in the order of the pivot, sorted here only when the caller has not cached it
+    if (pivot_order == NULL){
+        uint32_t *order = scratch_alloc(length * sizeof(*order));
+        numeric_type *ordered_values = scratch_alloc(length * sizeof(*ordered_values));
+        abandon_order(pivot_values, length, order, ordered_values);
+        pivot_order = order;
+        ordered_pivot_values = ordered_values;
+    }
+    #endif
+    
+    #if (defined(USE_SLIDING_STATS) || defined(USE_DOT_PRODUCT)) && !defined(USE_FIXED)
+    // Target windows are never copied nor normalized: their statistics come from the index, or from running sums updated in O(1) as the window slides
+    const numeric_type *ts_values = time_series->values;
+    // Without the index the running sums need the windows in order, so the scan starts at window 0
+    const uint32_t scan_start = (time_series->prefix_sums != NULL) ? first_window : 0;
+    double window_sum, window_squares_sum;
+    #if defined(USE_DOT_PRODUCT) && !defined(USE_ABS)
+    Dot_product_pivot dot_product_pivot;
+    dot_product_pivot_init(&dot_product_pivot, pivot_values, length);
+    #else
+    numeric_type offset, scale;
+    #endif
+    
+    // Loops over shapelets in the time-series
+    for(uint32_t k = 0; k < num_shapelets; k++){
+        i = outward_window(k, scan_start, num_shapelets);
+        window_sums(time_series, i, length, &window_sum, &window_squares_sum);
+        
+        // Compute shapelet-shapelet distance against the raw window
+        #if defined(USE_DOT_PRODUCT) && !defined(USE_ABS)
+        shapelet_distance = dot_product_distance(&dot_product_pivot, &ts_values[i], window_sum, window_squares_sum, abandon_distance);
+        #else
+        window_normalization_stats(window_sum, window_squares_sum, length, &offset, &scale);
+        #ifdef USE_REORDERED_ABANDON
+        shapelet_distance = ordered_euclidean_distance(ordered_pivot_values, &ts_values[i], pivot_order, length, offset, scale, abandon_distance);
+        #else
+        shapelet_distance = window_euclidean_distance(pivot_values, &ts_values[i], length, offset, scale, abandon_distance);
+        #endif
+        #endif
+        
+        // Keep the minimum distance between the pivot shapelet and all the time-series shapelets
+        if (distance_profile != NULL)
+            distance_profile[i] = shapelet_distance;
+        if (shapelet_distance < minimum_distance){
+            minimum_distance = shapelet_distance;
+            *best_window = i;
+            if (distance_profile == NULL)
+                abandon_distance = minimum_distance;
+        }
+    }
+    
+    #if defined(USE_DOT_PRODUCT) && !defined(USE_ABS)
+    dot_product_pivot_free(&dot_product_pivot);
+    #endif
+    
+    #else
+    numeric_type *target_values;
+    
+    // Allocate memory for target values 
+    // Pivot shapelet and ts shapelets must always have equal length
+    target_values = scratch_alloc(length * sizeof(*target_values));
+
+    // Loops over shapelets in the time-series
+    for(uint32_t k = 0; k < num_shapelets; k++){
+        i = outward_window(k, first_window, num_shapelets);
+        // initialize normalized values of time series shapelet starting at i
+        memcpy(target_values, &time_series->values[i], length * sizeof(*target_values));
+        
+        // Normalize target shapelet values
+        #ifdef USE_ZSCORE
+        zscore_normalization(target_values, length);
+        #else
+        algebric_normalization(target_values, length);
+        #endif
+        
+        // Compute shapelet-shapelet distance
+        #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+        shapelet_distance = ordered_euclidean_distance(ordered_pivot_values, target_values, pivot_order, length, 0, 1, abandon_distance);
+        #else
+        shapelet_distance = euclidean_distance(pivot_values, target_values, length, abandon_distance);
+        #endif
+        
+        // Keep the minimum distance between the pivot shapelet and all the time-series shapelets
+        if (distance_profile != NULL)
+            distance_profile[i] = shapelet_distance;
+        if (shapelet_distance < minimum_distance){
+            minimum_distance = shapelet_distance;
+            *best_window = i;
+            if (distance_profile == NULL)
+                abandon_distance = minimum_distance;
+        }
+        
+    }
+
+    #endif
+    
+    scratch_release(scratch_start);
+
+    return minimum_distance;
+}
+
+
+// Distance from a shapelet to an entire time-series
+// The cached normalized values of the shapelet are used when present, otherwise the pivot is normalized for this call only
+numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series){
+    uint32_t best_window;
+    
+    return shapelet_ts_distance_profile(pivot_shapelet, time_series, &best_window, NULL);
+}
+
+
+numeric_type shapelet_ts_distance_profile(Shapelet *pivot_shapelet, const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile){
+    numeric_type minimum_distance;
+    
+    *best_window = 0;
+    if (pivot_shapelet->normalized_values != NULL)
+        return ordered_shapelet_ts_distance_profile(pivot_shapelet->normalized_values, pivot_shapelet->pivot_order, pivot_shapelet->ordered_values, 
+                                                    pivot_shapelet->length, time_series, best_window, distance_profile);
+    
+    // Standalone call: the arena is sized for this pair (a no-op once it is large enough)
+    if (scratch_mark() == 0)
+        scratch_reserve(normalized_scratch_size(pivot_shapelet->length) + distance_scratch_size(pivot_shapelet->length, time_series->length));
+    shapelet_normalize(pivot_shapelet);
+    minimum_distance = ordered_shapelet_ts_distance_profile(pivot_shapelet->normalized_values, pivot_shapelet->pivot_order, pivot_shapelet->ordered_values, 
+                                                            pivot_shapelet->length, time_series, best_window, distance_profile);
+    shapelet_free_normalized(pivot_shapelet);
+    
+    return minimum_distance;
+}
+
+
+// Distance from a normalized candidate to a time series, scanned from the window after the best match of the previous 
+// candidate (*match_window, updated), where the next position of the same series usually matches
+// The candidate occurs verbatim in its own series, so its distance to it is 0 without scanning
+static inline numeric_type warm_candidate_distance(Shapelet *candidate, const Timeseries *time_series, uint32_t *match_window){
+    numeric_type distance;
+    
+    if (candidate->Ti == time_series){
+        *match_window = candidate->start_position + 1;
+        return 0;
+    }
+    distance = ordered_shapelet_ts_distance_profile(candidate->normalized_values, candidate->pivot_order, candidate->ordered_values, candidate->length, 
+                                                   time_series, match_window, NULL);
+    (*match_window)++;
+    return distance;
+}
+
+
+// F-Statistic based on distance measures and associated binary classes
+numeric_type bin_f_statistic(numeric_type *measured_distances, Timeseries *ts_set, uint16_t num_ts){
+    numeric_type f_stat;
+    #ifndef USE_FIXED
+    F_stat_accumulator acc;
+    #else
+    numeric_type total_dists_sum = 0.0, class_zero_sum = 0.0, class_one_sum = 0.0;
+    numeric_type total_dists_avg, class_zero_avg, class_one_avg;
+    numeric_type numerator_sum = 0.0, denominator_sum = 0.0, temp_difference;
+    uint16_t class_zero_ts_num = 0, class_one_ts_num = 0;
+    #endif
+    
+    if(num_ts <= 2)
+    {
+        printf("Number of time series must be greater than 2!");
+        exit(-1);
+    }
+
+    #ifndef USE_FIXED
+    // Same computation as the selection functions, in one pass
+    f_stat_accumulator_init(&acc, 2);
+    for(uint16_t i = 0; i < num_ts; i++)
+        f_stat_accumulator_add(&acc, measured_distances[i], ts_set[i].class);
+    f_stat = f_stat_accumulator_value(&acc);
+    f_stat_accumulator_free(&acc);
+    
+    #else
+    // Count the number of time series in each class and compute the sum of distaces for each class
+    for(uint16_t i = 0; i < num_ts; i++){
+        if (ts_set[i].class == 0){
+            class_zero_sum += measured_distances[i];
+            class_zero_ts_num++;
+        }
+        else if (ts_set[i].class == 1){
+            class_one_sum += measured_distances[i];
+            class_one_ts_num++;
+        }
+        else{
+            printf("Class is not binary");
+            exit(-1);
+        }
+    }
+
+    // Calculate average values for each class and for the entire distances array
+    class_zero_avg = fixedpt_div(class_zero_sum, fixedpt_fromint(class_zero_ts_num));
+    class_one_avg = fixedpt_div(class_one_sum, fixedpt_fromint(class_one_ts_num));
+    total_dists_sum = class_zero_sum + class_one_sum;
+    total_dists_avg = fixedpt_div(total_dists_sum, fixedpt_fromint(num_ts));
+    // Calculate the sum in f-stat formula numerator
+    numerator_sum = fixedpt_pow2(class_zero_avg - total_dists_avg) + fixedpt_pow2(class_one_avg - total_dists_avg);
+    // Calculate the sums in f-stat formula denominator
+    for(uint16_t i = 0; i < num_ts; i++){
+        if(ts_set[i].class == 0){
+            temp_difference = measured_distances[i] - class_zero_avg;
+        }
+        else if (ts_set[i].class == 1){
+            temp_difference = measured_distances[i] - class_one_avg;
+        }
+        else{
+            printf("Class is not binary");
+            exit(-1);
+        }
+        denominator_sum += fixedpt_pow2(temp_difference);
+        
+    }
+    if(denominator_sum == 0)
+    {
+        printf("Error calculating f statistic! Division by zero\n");
+        exit(-1);
+    }
+    
+    f_stat = fixedpt_div(numerator_sum, fixedpt_div(denominator_sum, (fixedpt_fromint(num_ts) - FIXEDPT_TWO)));
+    
+    #endif
+    
+    return f_stat;
+}
+
+
+void f_stat_accumulator_init(F_stat_accumulator *acc, uint16_t num_classes){
+    acc->num_classes = num_classes;
+    acc->counts = safe_alloc(num_classes * sizeof(*acc->counts));
+    acc->sums = safe_alloc(num_classes * sizeof(*acc->sums));
+    acc->centered_squares_sums = safe_alloc(num_classes * sizeof(*acc->centered_squares_sums));
+    f_stat_accumulator_reset(acc);
+}
+
+
+void f_stat_accumulator_reset(F_stat_accumulator *acc){
+    memset(acc->counts, 0, acc->num_classes * sizeof(*acc->counts));
+    memset(acc->sums, 0, acc->num_classes * sizeof(*acc->sums));
+    memset(acc->centered_squares_sums, 0, acc->num_classes * sizeof(*acc->centered_squares_sums));
+}
+
+
+void f_stat_accumulator_free(F_stat_accumulator *acc){
+    free(acc->counts);
+    free(acc->sums);
+    free(acc->centered_squares_sums);
+    acc->counts = NULL;
+    acc->sums = NULL;
+    acc->centered_squares_sums = NULL;
+}
+
+
+static inline void check_class(const F_stat_accumulator *acc, uint8_t class){
+    if (class >= acc->num_classes){
+        printf("Class %u out of the %u classes of the dataset\n", class, acc->num_classes);
+        exit(-1);
+    }
+}
+
+
+// Adds a distance to its class, updating the class mean and centered sum of squares in one pass (Welford), 
+// which avoids the cancellation of raw sums of squares
+void f_stat_accumulator_add(F_stat_accumulator *acc, numeric_type distance, uint8_t class){
+    #ifndef USE_FIXED
+    const double value = distance;
+    #else
+    const double value = fixedpt_tofloat(distance);
+    #endif
+    double previous_mean, mean;
+    
+    check_class(acc, class);
+    previous_mean = (acc->counts[class] > 0) ? acc->sums[class] / acc->counts[class] : 0.0;
+    acc->counts[class]++;
+    acc->sums[class] += value;
+    mean = acc->sums[class] / acc->counts[class];
+    acc->centered_squares_sums[class] += (value - previous_mean) * (value - mean);
+}
+
+
+// Adds count contiguous distances of the same class: their mean and centered sum of squares are reduced in two plain passes,
+// then combined with the class statistics (Chan et al. pairwise update)
+void f_stat_accumulator_add_class(F_stat_accumulator *acc, const numeric_type *distances, uint16_t count, uint8_t class){
+    double sum = 0.0, centered_squares_sum = 0.0, mean, delta;
+    
+    check_class(acc, class);
+    if (count == 0)
+        return;
+    for (uint16_t i = 0; i < count; i++){
+        #ifndef USE_FIXED
+        sum += distances[i];
+        #else
+        sum += fixedpt_tofloat(distances[i]);
+        #endif
+    }
+    mean = sum / count;
+    for (uint16_t i = 0; i < count; i++){
+        #ifndef USE_FIXED
+        centered_squares_sum += (distances[i] - mean) * (distances[i] - mean);
+        #else
+        centered_squares_sum += pow(fixedpt_tofloat(distances[i]) - mean, 2);
+        #endif
+    }
+    
+    if (acc->counts[class] > 0){
+        delta = mean - acc->sums[class] / acc->counts[class];
+        centered_squares_sum += delta * delta * ((double) acc->counts[class] * count / (acc->counts[class] + count));
+    }
+    acc->counts[class] += count;
+    acc->sums[class] += sum;
+    acc->centered_squares_sums[class] += centered_squares_sum;
+}
+
+
+// F-statistic of the distances added so far: the formula of bin_f_statistic for two classes, the one-way ANOVA F-statistic
+//   F = (sum_c n_c (m_c - m)^2 / (C - 1)) / (sum_c W_c / (n - C))
+// otherwise, over the C classes with distances
+numeric_type f_stat_accumulator_value(const F_stat_accumulator *acc){
+    uint32_t num_ts = 0;
+    uint16_t num_classes = 0;
+    double total_dists_avg, numerator_sum = 0.0, denominator_sum = 0.0, f_stat;
+    
+    for (uint16_t c = 0; c < acc->num_classes; c++){
+        if (acc->counts[c] == 0)
+            continue;
+        num_ts += acc->counts[c];
+        num_classes++;
+        numerator_sum += acc->sums[c];
+        denominator_sum += acc->centered_squares_sums[c];
+    }
+    if (num_classes < 2 || num_ts <= num_classes){
+        printf("Number of time series must be greater than the number of classes, with at least 2 classes!");
+        exit(-1);
+    }
+    if (denominator_sum == 0){
+        printf("Error calculating f statistic! Division by zero\n");
+        exit(-1);
+    }
+    total_dists_avg = numerator_sum / num_ts;
+    
+    numerator_sum = 0.0;
+    for (uint16_t c = 0; c < acc->num_classes; c++){
+        if (acc->counts[c] == 0)
+            continue;
+        // Binary case: unweighted squared differences of the class means, as in bin_f_statistic
+        if (num_classes == 2)
+            numerator_sum += pow(acc->sums[c] / acc->counts[c] - total_dists_avg, 2);
+        else
+            numerator_sum += acc->counts[c] * pow(acc->sums[c] / acc->counts[c] - total_dists_avg, 2);
+    }
+    f_stat = (numerator_sum / (num_classes - 1)) / (denominator_sum / (num_ts - num_classes));
+    
+    #ifndef USE_FIXED
+    return f_stat;
+    #else
+    return fixedpt_rconst(f_stat);
+    #endif
+}
+
+
+// The within-class sum of squares W can only grow as the remaining distances are added to the classes, and each class mean 
+// lies between the means with the remaining distances at their lower and upper sums. The between-class term is then bounded:
+//   binary, F = w (m0 - m1)^2 / (W / (n - 2)) with w = (n0^2 + n1^2) / n^2, by the largest |m0 - m1|
+//   otherwise, since the overall mean minimizes sum_c n_c (m_c - a)^2 over a, by taking each m_c at the end of its interval 
+//   farthest from a, with a the weighted mean of the interval centers
+double f_stat_accumulator_bound(const F_stat_accumulator *acc, const uint16_t *class_sizes, const double *remaining_lower_sums, const double *remaining_upper_sums){
+    const uint16_t num_classes = acc->num_classes;
+    uint32_t num_ts = 0;
+    double within_sum = 0.0, between_sum = 0.0, center = 0.0;
+    double lowest_means[num_classes], highest_means[num_classes];
+    
+    for (uint16_t c = 0; c < num_classes; c++){
+        const uint8_t complete = (acc->counts[c] == class_sizes[c]);
+        if (class_sizes[c] == 0){
+            lowest_means[c] = highest_means[c] = 0.0;
+            continue;
+        }
+        num_ts += class_sizes[c];
+        within_sum += acc->centered_squares_sums[c];
+        lowest_means[c] = (acc->sums[c] + (complete ? 0.0 : fmax(remaining_lower_sums[c], 0.0))) / class_sizes[c];
+        highest_means[c] = (acc->sums[c] + (complete ? 0.0 : remaining_upper_sums[c])) / class_sizes[c];
+        center += class_sizes[c] * (lowest_means[c] + highest_means[c]) / 2;
+    }
+    if (within_sum <= 0.0)
+        return INFINITY;
+    
+    if (num_classes == 2){
+        const double between_weight = ((double) class_sizes[0] * class_sizes[0] + (double) class_sizes[1] * class_sizes[1]) / ((double) num_ts * num_ts);
+        const double spread = fmax(highest_means[0] - lowest_means[1], highest_means[1] - lowest_means[0]);
+        return between_weight * spread * spread * (num_ts - 2) / within_sum;
+    }
+    
+    center /= num_ts;
+    for (uint16_t c = 0; c < num_classes; c++){
+        const double farthest = fmax(fabs(lowest_means[c] - center), fabs(highest_means[c] - center));
+        between_sum += class_sizes[c] * farthest * farthest;
+    }
+    return (between_sum / (num_classes - 1)) / (within_sum / (num_ts - num_classes));
+}
+
+
+#ifdef QUALITY_PRUNING
+// Evaluation order of the time series and class sizes, used to bound the F-statistic of a partially evaluated candidate
+typedef struct{
+    uint16_t num_ts;
+    uint16_t num_classes;
+    uint16_t *class_sizes;
+    uint16_t *order;                    // Time series taking the classes in turn, so that every class mean is narrowed at the same pace
+} Quality_pruning;
+
+
+static void quality_pruning_init(Quality_pruning *pruning, const Timeseries *T, uint16_t num_ts, uint16_t num_classes){
+    uint16_t *next = safe_alloc(num_classes * sizeof(*next)), n = 0;
+    
+    pruning->num_ts = num_ts;
+    pruning->num_classes = num_classes;
+    pruning->class_sizes = safe_alloc(num_classes * sizeof(*pruning->class_sizes));
+    memset(pruning->class_sizes, 0, num_classes * sizeof(*pruning->class_sizes));
+    memset(next, 0, num_classes * sizeof(*next));
+    for (uint16_t j = 0; j < num_ts; j++)
+        pruning->class_sizes[T[j].class]++;
+    
+    // Take the next time series of each class in turn, until all are exhausted
+    pruning->order = safe_alloc(num_ts * sizeof(*pruning->order));
+    while (n < num_ts){
+        for (uint16_t class = 0; class < num_classes; class++){
+            while (next[class] < num_ts && T[next[class]].class != class)
+                next[class]++;
+            if (next[class] < num_ts)
+                pruning->order[n++] = next[class]++;
+        }
+    }
+    free(next);
+}
+
+
+static void quality_pruning_free(Quality_pruning *pruning){
+    free(pruning->class_sizes);
+    free(pruning->order);
+    pruning->class_sizes = NULL;
+    pruning->order = NULL;
+}
+
+
+// Bounds of the distances from the last candidate scored by a thread to each time series, carried to the next candidate
+typedef struct{
+    uint32_t length;                    // Length of the last candidate, 0 before the first one
+    numeric_type *previous_values;      // Normalized values of the last candidate
+    double *lower_bounds;               // Both equal to the distance when it was computed
+    double *upper_bounds;
+    double *remaining_lower_sums;       // Sums of the bounds of the distances not computed yet, per class
+    double *remaining_upper_sums;
+} Distance_bounds;
+
+
+static void distance_bounds_init(Distance_bounds *bounds, uint16_t num_ts, uint16_t num_classes, uint32_t max_length){
+    bounds->length = 0;
+    bounds->previous_values = safe_alloc(max_length * sizeof(*bounds->previous_values));
+    bounds->lower_bounds = safe_alloc(num_ts * sizeof(*bounds->lower_bounds));
+    bounds->upper_bounds = safe_alloc(num_ts * sizeof(*bounds->upper_bounds));
+    bounds->remaining_lower_sums = safe_alloc(num_classes * sizeof(*bounds->remaining_lower_sums));
+    bounds->remaining_upper_sums = safe_alloc(num_classes * sizeof(*bounds->remaining_upper_sums));
+}
+
+
+static void distance_bounds_free(Distance_bounds *bounds){
+    free(bounds->previous_values);
+    free(bounds->lower_bounds);
+    free(bounds->upper_bounds);
+    free(bounds->remaining_lower_sums);
+    free(bounds->remaining_upper_sums);
+}
+
+
+// Upper bound of the distance from a normalized candidate to any window: the norm of a difference is at most the sum of the norms,
+// and a normalized window has a squared norm of at most length (z-score, population or sample) or 1 (algebric normalization)
+static double candidate_distance_bound(const Shapelet *candidate){
+    double pivot_squares_sum = 0.0, norms_sum;
+    
+    for (uint32_t i = 0; i < candidate->length; i++)
+        pivot_squares_sum += (double) candidate->normalized_values[i] * candidate->normalized_values[i];
+    #ifdef USE_ZSCORE
+    norms_sum = sqrt(pivot_squares_sum) + sqrt((double) candidate->length);
+    #else
+    norms_sum = sqrt(pivot_squares_sum) + 1.0;
+    #endif
+    
+    #ifdef USE_ABS
+    // Sum of absolute differences, at most sqrt(length) times the euclidean norm (Cauchy-Schwarz)
+    return sqrt((double) candidate->length) * norms_sum;
+    #else
+    return norms_sum * norms_sum;
+    #endif
+}
+
+
+// Moves the distance bounds from the last candidate to a new one of the same length, by the triangle inequality:
+// the minimum distance of the new candidate to a series is within their distance (step) of the minimum distance of the last candidate
+// to that series (on the euclidean norm, the square root of the squared distance, or directly on the sum of absolute differences)
+// Consecutive positions give close normalized candidates, hence tight bounds
+static void distance_bounds_move(Distance_bounds *bounds, const Shapelet *candidate, uint16_t num_ts){
+    double step = 0.0;
+    
+    if (bounds->length != candidate->length){
+        for (uint16_t j = 0; j < num_ts; j++){
+            bounds->lower_bounds[j] = 0.0;
+            bounds->upper_bounds[j] = INFINITY;
+        }
+    }
+    else{
+        for (uint32_t i = 0; i < candidate->length; i++){
+            const double difference = (double) candidate->normalized_values[i] - bounds->previous_values[i];
+            #ifdef USE_ABS
+            step += fabs(difference);
+            #else
+            step += difference * difference;
+            #endif
+        }
+        #ifdef USE_ABS
+        for (uint16_t j = 0; j < num_ts; j++){
+            bounds->lower_bounds[j] = fmax(bounds->lower_bounds[j] - step, 0.0);
+            bounds->upper_bounds[j] += step;
+        }
+        #else
+        step = sqrt(step);
+        for (uint16_t j = 0; j < num_ts; j++){
+            bounds->lower_bounds[j] = pow(fmax(sqrt(bounds->lower_bounds[j]) - step, 0.0), 2);
+            bounds->upper_bounds[j] = pow(sqrt(bounds->upper_bounds[j]) + step, 2);
+        }
+        #endif
+    }
+    
+    bounds->length = candidate->length;
+    memcpy(bounds->previous_values, candidate->normalized_values, candidate->length * sizeof(*bounds->previous_values));
+}
+
+
+// Adds the distances from a normalized candidate to the time series in T into quality, in the order of the pruning plan, 
+// counting the ones computed (all but the self match) in num_distances. Whenever the F-statistic of the candidate is bounded below quality_threshold, whatever the
+// distances still to be computed (within their bounds), the candidate is abandoned and 0 is returned
+static uint8_t bounded_candidate_quality(const Quality_pruning *pruning, Distance_bounds *bounds, Shapelet *candidate, Timeseries *T, 
+                                         uint32_t *match_windows, numeric_type quality_threshold, F_stat_accumulator *quality, uint64_t *num_distances){
+    const uint16_t num_ts = pruning->num_ts;
+    double *remaining_lower_sums = bounds->remaining_lower_sums, *remaining_upper_sums = bounds->remaining_upper_sums;
+    double generic_bound, rounding_slack;
+    
+    distance_bounds_move(bounds, candidate, num_ts);
+    f_stat_accumulator_reset(quality);
+    
+    // Nothing to prune against until k shapelets are known
+    if (quality_threshold == -INFINITY){
+        for (uint16_t j = 0; j < num_ts; j++){
+            const numeric_type distance = warm_candidate_distance(candidate, &T[j], &match_windows[j]);
+            f_stat_accumulator_add(quality, distance, T[j].class);
+            bounds->lower_bounds[j] = bounds->upper_bounds[j] = distance;
+        }
+        // The distance to the candidate's own series is not computed (warm_candidate_distance)
+        *num_distances += num_ts - 1;
+        return 1;
+    }
+    
+    // Bounds of the distances still to be computed, widened to cover the rounding of the computed distances
+    generic_bound = candidate_distance_bound(candidate);
+    rounding_slack = generic_bound * QUALITY_PRUNING_MARGIN;
+    memset(remaining_lower_sums, 0, pruning->num_classes * sizeof(*remaining_lower_sums));
+    memset(remaining_upper_sums, 0, pruning->num_classes * sizeof(*remaining_upper_sums));
+    for (uint16_t j = 0; j < num_ts; j++){
+        bounds->upper_bounds[j] = fmin(bounds->upper_bounds[j], generic_bound);
+        remaining_lower_sums[T[j].class] += fmax(bounds->lower_bounds[j] - rounding_slack, 0.0);
+        remaining_upper_sums[T[j].class] += bounds->upper_bounds[j] + rounding_slack;
+    }
+    
+    for (uint16_t n = 0; n < num_ts; n++){
+        const uint16_t j = pruning->order[n];
+        const uint8_t class = T[j].class;
+        const numeric_type distance = warm_candidate_distance(candidate, &T[j], &match_windows[j]);
+        
+        *num_distances += (candidate->Ti != &T[j]);
+        f_stat_accumulator_add(quality, distance, class);
+        remaining_lower_sums[class] -= fmax(bounds->lower_bounds[j] - rounding_slack, 0.0);
+        remaining_upper_sums[class] -= bounds->upper_bounds[j] + rounding_slack;
+        bounds->lower_bounds[j] = bounds->upper_bounds[j] = distance;
+        
+        if (n + 1 < num_ts && 
+            f_stat_accumulator_bound(quality, pruning->class_sizes, remaining_lower_sums, remaining_upper_sums) * (1.0 + QUALITY_PRUNING_MARGIN) < quality_threshold)
+            return 0;
+    }
+    
+    return 1;
+}
+
+
+// Quality of the k-th best shapelet when top is full, below which candidates are rejected, -INFINITY otherwise
+static inline numeric_type top_k_threshold(const Top_k *top){
+    return (top->k > 0 && top->num_shapelets == top->k) ? top->shapelets[top->k - 1].quality : -INFINITY;
+}
+
+
+// Quality of the k-th best shapelet merged so far (the k shapelets start zeroed, and the F-statistic is never negative)
+static inline numeric_type k_shapelets_threshold(const Shapelet *k_shapelets, uint16_t k){
+    return (k > 0) ? k_shapelets[k - 1].quality : -INFINITY;
+}
+
+
+// Abandoned candidates keep their slot, and are dropped with the self similars since they have no time series
+static inline void abandon_candidate(Shapelet *candidate){
+    candidate->Ti = NULL;
+    candidate->quality = -INFINITY;
+}
+
+
+// Out of the distances that are not self matches (see print_self_match_savings)
+static void print_pruning_savings(uint64_t num_distances, uint64_t total_num_distances){
+    printf("Quality pruning: %llu of %llu distances computed, %llu saved (%.2f%%)\n", (unsigned long long) num_distances, 
+           (unsigned long long) total_num_distances, (unsigned long long) (total_num_distances - num_distances),
+           (total_num_distances > 0) ? 100.0 * (total_num_distances - num_distances) / total_num_distances : 0.0);
+}
+#endif
+
+
+// Distances from the candidates to their own series are 0, and are not computed
+static void print_self_match_savings(uint64_t total_num_shapelets, uint16_t num_ts){
+    printf("Self matches: %llu of %llu distances skipped (%.2f%%)\n", (unsigned long long) (total_num_shapelets * num_ts), 
+           (unsigned long long) (total_num_shapelets * num_ts * num_ts), 100.0 / num_ts);
+}
+
+
+// Compare shapelets quality measures for sorting with qsort()
+static int compare_shapelets(const void *shapelet_1, const void *shapelet_2){
+    const numeric_type shapelet_1_quality = ((const Shapelet *)shapelet_1)->quality;
+    const numeric_type shapelet_2_quality = ((const Shapelet *)shapelet_2)->quality;
+    
+    if (shapelet_1_quality < shapelet_2_quality)
+    {
+        return 1;
+    }
+    else if (shapelet_1_quality > shapelet_2_quality)
+    {
+        return -1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+// Index of the first candidate of length l among the candidates of lengths min, min + 1, ..., of a time series with the given length
+// (closed form of the sum of ts_length - l' + 1 for l' from min to l - 1). Every selector stores the candidate (l, position) at 
+// candidate_offset + position, so that threads write disjoint slots without any lock, in the order of the sequential loops
+static inline uint64_t candidate_offset(uint32_t ts_length, uint16_t min, uint16_t l){
+    return (uint64_t) (l - min) * (2 * (uint64_t) ts_length - min - l + 3) / 2;
+}
+
+
+#if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+
+// Distances from every candidate of T[i] with length between min and max to T[j], stored in block_distances in the format [candidate][j]
+// The accumulators are grown from one length to the next, instead of recomputing every dot product and window sum at each length
+static void length_block_distances(Timeseries *T, uint16_t num_ts, uint16_t i, uint16_t j, uint16_t min, uint16_t max, 
+                                   numeric_type *block_distances, numeric_type *length_distances){
+    Length_accumulators acc;
+    
+    // Each candidate of T[i] occurs verbatim in T[i]
+    if (j == i){
+        for (uint64_t c = 0; c < candidate_offset(T[i].length, min, max + 1); c++)
+            block_distances[(size_t) c * num_ts + j] = 0;
+        return;
+    }
+    length_accumulators_init(&acc, &T[i], &T[j], min);
+    for (uint16_t l = min; l <= max; l++){
+        const uint64_t offset = candidate_offset(T[i].length, min, l);
+        const uint32_t num_shapelets = T[i].length - l + 1;
+        
+        if (l > min)
+            length_accumulators_grow(&acc);
+        length_accumulators_distances(&acc, length_distances);
+        for (uint32_t position = 0; position < num_shapelets; position++)
+            block_distances[(size_t) (offset + position) * num_ts + j] = length_distances[position];
+    }
+    length_accumulators_free(&acc);
+}
+
+
+// Assemble the candidates of T[i] with length between min and max, with their qualities from the [candidate][j] distances of length_block_distances
+// The candidates are stored in block_shapelets, or streamed into top when it is not NULL (USE_STREAMING_TOP_K)
+static void length_block_candidates(Timeseries *T, uint16_t num_ts, uint16_t i, uint16_t min, uint16_t max, 
+                                    const numeric_type *block_distances, Shapelet *block_shapelets, Top_k *top){
+    Shapelet shapelet_candidate;
+    F_stat_accumulator quality;
+    
+    f_stat_accumulator_init(&quality, dataset_num_classes(T, num_ts));
+    for (uint16_t l = min; l <= max; l++){
+        const uint64_t offset = candidate_offset(T[i].length, min, l);
+        const uint32_t num_shapelets = T[i].length - l + 1;
+        
+        for (uint32_t position = 0; position < num_shapelets; position++){
+            const numeric_type *candidate_distances = &block_distances[(size_t) (offset + position) * num_ts];
+            
+            shapelet_candidate = init_shapelet(&T[i], position, l);
+            // F-Statistic as shapelet quality measure, reduced over the runs of time series of the same class 
+            // (a single run per class when the dataset is sorted by class)
+            f_stat_accumulator_reset(&quality);
+            for (uint16_t j = 0, run_end; j < num_ts; j = run_end){
+                for (run_end = j + 1; run_end < num_ts && T[run_end].class == T[j].class; run_end++);
+                f_stat_accumulator_add_class(&quality, &candidate_distances[j], run_end - j, T[j].class);
+            }
+            shapelet_candidate.quality = f_stat_accumulator_value(&quality);
+            if (top != NULL)
+                top_k_insert(top, shapelet_candidate);
+            else
+                block_shapelets[offset + position] = shapelet_candidate;
+        }
+    }
+    f_stat_accumulator_free(&quality);
+}
+#endif
+
+
+// SHAPELET CACHED SELECTION (from algorithm 3 in "Classification of time series by shapelet transformation", Hills et al., 2013)
+// Given a set T of time series attatched to labels, extract shapelets exhaustively from min to max lengths, keeping only the k best shapelets according to some criteria 
+// (DESTROY ALL k RETURNED SHAPELETS AFTER USAGE)
+Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k){
+    uint64_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
+    const uint16_t num_classes = dataset_num_classes(T, num_ts);
+    Shapelet *k_shapelets;
+    #ifdef USE_STREAMING_TOP_K
+    Top_k top;              // candidates are streamed into the k best ones, instead of being kept for each time series
+    #else
+    uint64_t num_merged_shapelets; //total number of shapelets to be merged after removing self similars
+    Shapelet *ts_shapelets;
+    #endif
+    #if !defined(USE_BATCHED_DISTANCES) || defined(USE_FIXED) || defined(USE_ABS)
+    #ifndef USE_STREAMING_TOP_K
+    uint64_t shapelets_index;
+    #endif
+    uint32_t num_shapelets; //number of shapelets of lenght l 
+    Shapelet shapelet_candidate;
+    // Class statistics of the distances from the current candidate to each time series, reused for each candidate shapelet
+    F_stat_accumulator quality;
+    // Window of each time series where the scan of the next candidate starts
+    uint32_t *match_windows;
+    #endif
+    #ifdef QUALITY_PRUNING
+    Quality_pruning pruning;
+    Distance_bounds bounds;
+    numeric_type quality_threshold;
+    uint64_t num_distances = 0;         // distances actually computed
+    #endif
+
+    //checks to assert if the parameters are valid
+    if (min > max){
+        printf("Min greater than max");
+        exit(-1);
+    }
+
+    if(num_classes < 2 || num_ts <= num_classes)
+    {
+        printf("Number of time series must be greater than the number of classes, with at least 2 classes");
+        exit(-1);
+    }
+
+    k_shapelets = safe_alloc(k*sizeof(*k_shapelets));
+    if(memset(k_shapelets, 0, k * sizeof(*k_shapelets)) == NULL)
+    {
+        printf("Error on memset k_shapelets\n");
+        exit(-1);
+    }
+
+    // total number of shapelets in each T[i] 
+    total_num_shapelets = candidate_offset(T->length, min, max + 1);
+    printf("Total number of shapelets for each time-series: %llu\n", (unsigned long long) total_num_shapelets);
+    // Every temporary of the candidate loop is drawn from the scratch arena, sized once
+    scratch_reserve(selection_scratch_size(T->length, max));
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // Distances from every candidate to each time series, in the format [candidate][j]
+    numeric_type *batch_distances = safe_alloc((size_t) total_num_shapelets * num_ts * sizeof(*batch_distances));
+    numeric_type *length_distances = safe_alloc(T->length * sizeof(*length_distances));
+    #endif
+    #ifdef USE_STREAMING_TOP_K
+    top_k_init(&top, k);
+    #endif
+    #if !defined(USE_BATCHED_DISTANCES) || defined(USE_FIXED) || defined(USE_ABS)
+    f_stat_accumulator_init(&quality, num_classes);
+    match_windows = safe_alloc(num_ts * sizeof(*match_windows));
+    memset(match_windows, 0, num_ts * sizeof(*match_windows));
+    #endif
+    #ifdef QUALITY_PRUNING
+    quality_pruning_init(&pruning, T, num_ts, num_classes);
+    distance_bounds_init(&bounds, num_ts, num_classes, max);
+    #endif
+    
+    // For each time-series T[i] in T
     for (int i = 0; i < num_ts; i++){
+        #ifndef USE_STREAMING_TOP_K
         ts_shapelets = safe_alloc(total_num_shapelets * sizeof(*ts_shapelets));
-        shapelets_index = 0;
+        #endif
+        #if defined(QUALITY_PRUNING) && !defined(USE_STREAMING_TOP_K)
+        // Candidates of T[i] worse than the k-th shapelet of the previous time series can never be merged
+        quality_threshold = k_shapelets_threshold(k_shapelets, k);
+        #endif
         printf("[TS %u]\n", i);
+        #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+        // All the candidates of every length are evaluated at once against each time series in T
+        for (int j = 0; j < num_ts; j++)
+            length_block_distances(T, num_ts, i, j, min, max, batch_distances, length_distances);
+        #ifdef USE_STREAMING_TOP_K
+        length_block_candidates(T, num_ts, i, min, max, batch_distances, NULL, &top);
+        #else
+        length_block_candidates(T, num_ts, i, min, max, batch_distances, ts_shapelets, NULL);
+        #endif
+        #else
+        #ifndef USE_STREAMING_TOP_K
+        shapelets_index = 0;
+        #endif
         // For each length between min and max
         for (int l = min; l <= max; l++){ 
             num_shapelets = T->length - l + 1;    
@@ -398,20 +1766,46 @@ Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t mi
             for (int position = 0; position < num_shapelets; position++){
                 shapelet_candidate = init_shapelet(&T[i], position, l);               
                 // Assemble each shapelet on the fly, instead of keeping them in a matrix
+                // The candidate is normalized once and reused against every time series
+                shapelet_normalize(&shapelet_candidate);
+                #ifdef QUALITY_PRUNING
+                #ifdef USE_STREAMING_TOP_K
+                quality_threshold = top_k_threshold(&top);
+                #endif
+                // Calculate distances from current shapelet candidate to each time series in T, until it can't reach the k best
+                if (!bounded_candidate_quality(&pruning, &bounds, &shapelet_candidate, T, match_windows, quality_threshold, &quality, &num_distances)){
+                    shapelet_free_normalized(&shapelet_candidate);
+                    abandon_candidate(&shapelet_candidate);
+                    #ifndef USE_STREAMING_TOP_K
+                    ts_shapelets[shapelets_index] = shapelet_candidate;
+                    shapelets_index++;
+                    #endif
+                    continue;
+                }
+                #else
                 // Calculate distances from current shapelet candidate to each time series in T, 
+                f_stat_accumulator_reset(&quality);
                 for (int j = 0; j < num_ts; j++){
-                    shapelet_distances[j] = shapelet_ts_distance(&shapelet_candidate, &T[j]);   
+                    f_stat_accumulator_add(&quality, warm_candidate_distance(&shapelet_candidate, &T[j], &match_windows[j]), T[j].class);
                 }
+                #endif
+                shapelet_free_normalized(&shapelet_candidate);
 
                 // F-Statistic as shapelet quality measure
-                shapelet_candidate.quality = bin_f_statistic(shapelet_distances, T, num_ts);
+                shapelet_candidate.quality = f_stat_accumulator_value(&quality);
                 
+                #ifdef USE_STREAMING_TOP_K
+                top_k_insert(&top, shapelet_candidate);
+                #else
                 // Store every shapelet of T[i] with its quality measure and length in the format [quality, length, shapelet] with shapelet = [s1, s2, ..., sl] 
                 ts_shapelets[shapelets_index] = shapelet_candidate;
                 shapelets_index++;
-            }         
+                #endif
+            }
         }  // Here all shapelets from T[i] should have been stored together with its quality measures in ts_shapelets                                                             
+        #endif
         
+        #ifndef USE_STREAMING_TOP_K
         // Sort shapelets by quality
         qsort(ts_shapelets, (size_t) total_num_shapelets, sizeof(*ts_shapelets), compare_shapelets);
         // Remove self similar shapelets
@@ -420,83 +1814,327 @@ Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t mi
         // Merge ts_shapelets with k_shapelets and keep only best k shapelets, destroying all total_num_shapelets in ts_shapelets
         merge_shapelets(k_shapelets, k, ts_shapelets, num_merged_shapelets);
         free(ts_shapelets);
+        #endif
+    }
+    
+    #ifdef USE_STREAMING_TOP_K
+    top_k_to_array(&top, k_shapelets);
+    top_k_free(&top);
+    #endif
+    print_self_match_savings(total_num_shapelets, num_ts);
+    #ifdef QUALITY_PRUNING
+    quality_pruning_free(&pruning);
+    distance_bounds_free(&bounds);
+    print_pruning_savings(num_distances, total_num_shapelets * num_ts * (num_ts - 1));
+    #endif
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    free(batch_distances);
+    free(length_distances);
+    #else
+    f_stat_accumulator_free(&quality);
+    free(match_windows);
+    #endif
+
+    return k_shapelets;
+}
+
+// State shared by the tasks of multi_thread_shapelet_cached_selection
+typedef struct{
+    Shapelet *k_shapelets;
+    uint16_t k;
+    uint16_t next_merge;                // Next time series to be merged into k_shapelets, merges follow the order of T
+    uint16_t num_in_flight;             // Time series submitted and not merged yet
+    struct Series_candidates *series_array;
+    uint16_t num_ts;
+    uint16_t num_classes;
+    double *thread_predicted_costs;     // Load of each worker, as predicted by the cost model and as measured
+    double *thread_measured_times;      // (processor time of the tasks, each worker only updates its own entry)
+    uint32_t *thread_num_tasks;
+    #ifdef USE_STREAMING_TOP_K
+    Top_k *thread_top_k;                // k best candidates of each worker, merged at the end
+    #endif
+    #ifdef QUALITY_PRUNING
+    Quality_pruning pruning;
+    numeric_type quality_threshold;     // Quality of the k-th shapelet merged so far, no candidate below it can be merged later
+    uint64_t num_distances;             // Distances actually computed, updated atomically
+    #endif
+    pthread_mutex_t mutex;              // Protects the merge and the counters
+    pthread_cond_t series_merged;
+} Selection_state;
+
+// Candidates of one time series T[i], assembled by several tasks
+typedef struct Series_candidates{
+    Selection_state *selection;
+    Timeseries *T;
+    uint16_t num_ts;
+    uint16_t i;
+    uint16_t min;
+    uint16_t max;
+    Shapelet *ts_shapelets;             // Each candidate is written in its slot (candidate_offset + position), so no lock is taken
+    uint64_t total_num_shapelets;
+    uint64_t num_shapelets;             // Number of shapelets after the removal of self similars
+    uint32_t num_pending_tasks;         // The task that brings it to zero finalizes the time series
+    uint8_t ready;                      // Finalized, waiting for the merges of the previous time series
+    struct Candidate_task *tasks;
+} Series_candidates;
+
+// Candidates of T[i] with lengths min to max and positions first_position to last_position (bounded by each length)
+typedef struct Candidate_task{
+    Series_candidates *series;
+    uint16_t min;
+    uint16_t max;
+    uint32_t first_position;
+    uint32_t last_position;
+    double predicted_cost;
+} Candidate_task;
+
+
+// Predicted cost of the distances from one candidate of a given length to one time series, in elements visited
+// (without early abandon, which depends on the data)
+static double candidate_distance_cost(uint32_t length, uint32_t ts_length){
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // Grown accumulators: one dot product per window
+    return (double) (ts_length - length + 1);
+    #else
+    #if defined(USE_MASS) && !defined(USE_FIXED) && !defined(USE_ABS)
+    if (mass_is_cheaper(length, ts_length)){
+        const uint32_t fft_length = next_power_of_two(ts_length);
+        return MASS_COST_FACTOR * fft_length * log2(fft_length);
+    }
+    #endif
+    return (double) (ts_length - length + 1) * length;
+    #endif
+}
+
+
+// Splits the candidates of a time series into tasks of about the same predicted cost, num_threads * POOL_TASKS_PER_THREAD of them
+// Batched tasks take every position of a block of lengths, since the accumulators are grown along the lengths
+// Returns the number of tasks, and only counts them when tasks is NULL
+static uint32_t plan_candidate_tasks(uint32_t ts_length, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t num_threads, Candidate_task *tasks){
+    double series_cost = 0.0, task_cost;
+    uint32_t num_tasks = 0;
+    
+    for (uint16_t l = min; l <= max; l++)
+        series_cost += (double) (ts_length - l + 1) * num_ts * candidate_distance_cost(l, ts_length);
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // One block per thread, larger blocks reuse the accumulators longer
+    task_cost = series_cost / num_threads;
+    for (uint16_t l = min; l <= max;){
+        const uint16_t first_length = l;
+        // The first length of a block initializes the accumulators, in O(l) per dot product, about the same for every block
+        const double initialization_cost = (double) (ts_length - l + 1) * num_ts * candidate_distance_cost(l, ts_length) * (l - 1);
+        double cost = 0.0;
+        
+        for (; l <= max && cost < task_cost; l++)
+            cost += (double) (ts_length - l + 1) * num_ts * candidate_distance_cost(l, ts_length);
+        if (tasks != NULL){
+            tasks[num_tasks].min = first_length;
+            tasks[num_tasks].max = l - 1;
+            tasks[num_tasks].first_position = 0;
+            tasks[num_tasks].last_position = ts_length - first_length;
+            tasks[num_tasks].predicted_cost = initialization_cost + cost;
+        }
+        num_tasks++;
+    }
+    #else
+    task_cost = series_cost / ((double) num_threads * POOL_TASKS_PER_THREAD);
+    for (uint16_t l = min; l <= max; l++){
+        const uint32_t num_positions = ts_length - l + 1;
+        const double position_cost = num_ts * candidate_distance_cost(l, ts_length);
+        uint32_t positions_per_task = (uint32_t) ceil(task_cost / position_cost);
+        
+        if (positions_per_task < 1)
+            positions_per_task = 1;
+        for (uint32_t position = 0; position < num_positions; position += positions_per_task){
+            if (tasks != NULL){
+                tasks[num_tasks].min = l;
+                tasks[num_tasks].max = l;
+                tasks[num_tasks].first_position = position;
+                tasks[num_tasks].last_position = (num_positions - position > positions_per_task) ? position + positions_per_task - 1 : num_positions - 1;
+                tasks[num_tasks].predicted_cost = (tasks[num_tasks].last_position - position + 1) * position_cost;
+            }
+            num_tasks++;
+        }
     }
+    #endif
     
-    free(shapelet_distances);   // finally free the used shapelet_distances array
+    return num_tasks;
+}
 
-    return k_shapelets;
+
+// Merges, in the order of T, every time series already finalized (selection mutex held)
+static void merge_ready_series(Selection_state *selection){
+    while (selection->next_merge < selection->num_ts && selection->series_array[selection->next_merge].ready){
+        Series_candidates *series = &selection->series_array[selection->next_merge];
+        
+        #ifndef USE_STREAMING_TOP_K
+        // Merge ts_shapelets with k_shapelets and keep only best k shapelets, destroying all the shapelets in ts_shapelets
+        merge_shapelets(selection->k_shapelets, selection->k, series->ts_shapelets, series->num_shapelets);
+        #ifdef QUALITY_PRUNING
+        selection->quality_threshold = k_shapelets_threshold(selection->k_shapelets, selection->k);
+        #endif
+        #endif
+        free(series->ts_shapelets);
+        free(series->tasks);
+        series->ts_shapelets = NULL;
+        series->tasks = NULL;
+        
+        selection->next_merge++;
+        selection->num_in_flight--;
+        pthread_cond_broadcast(&selection->series_merged);
+    }
 }
 
-//thread specific global variables and structures:
-typedef struct{
-    Shapelet * ts_shapelets;
-    uint16_t *shapelets_index;
-    uint16_t num_ts;
-    Timeseries * T; //pointer to  timeseries array
-    uint16_t i;     // current timeseries index
-    pthread_mutex_t * mutex;
-    uint16_t max;
-    uint16_t min;
-} Thread_args;  // thread containing the argument for each thread function
+
+// Sorts the candidates of a time series and removes the self similars, in the worker that finished its last task
+static void finalize_series(Series_candidates *series){
+    Selection_state *selection = series->selection;
+    
+    #ifndef USE_STREAMING_TOP_K
+    // Sort shapelets by quality
+    qsort(series->ts_shapelets, (size_t) series->total_num_shapelets, sizeof(*series->ts_shapelets), compare_shapelets);
+    // Remove self similar shapelets
+    series->num_shapelets = series->total_num_shapelets;
+    series->ts_shapelets = remove_self_similars(series->ts_shapelets, &series->num_shapelets);
+    #endif
+    
+    pthread_mutex_lock(&selection->mutex);
+        series->ready = 1;
+        merge_ready_series(selection);
+    pthread_mutex_unlock(&selection->mutex);
+}
 
 
-static void *task_shapelet_candidates(void * arg)
+static void task_shapelet_candidates(void *arg)
 {
-    uint32_t num_shapelets; //number of shapelets of lenght l 
+    Candidate_task *task = (Candidate_task *) arg;
+    Series_candidates *series = task->series;
+    Timeseries *T = series->T;
+    const uint16_t num_ts = series->num_ts, i = series->i;
+    const int32_t worker = thread_pool_worker_id();
+    struct timespec start, end;
+    
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    
+    // Each worker draws the temporaries of its candidate loop from its own scratch arena
+    scratch_reserve(selection_scratch_size(T->length, series->max));
+
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // The accumulators are carried across the block of lengths of this task, against each time series in T
+    const uint64_t block_offset = candidate_offset(T[i].length, series->min, task->min);
+    const uint64_t block_num_shapelets = candidate_offset(T[i].length, series->min, task->max + 1) - block_offset;
+    numeric_type *block_distances = safe_alloc((size_t) block_num_shapelets * num_ts * sizeof(*block_distances));
+    numeric_type *length_distances = safe_alloc(T->length * sizeof(*length_distances));
+    
+    for (int j = 0; j < num_ts; j++)
+        length_block_distances(T, num_ts, i, j, task->min, task->max, block_distances, length_distances);
+    #ifdef USE_STREAMING_TOP_K
+    length_block_candidates(T, num_ts, i, task->min, task->max, block_distances, NULL, &series->selection->thread_top_k[worker]);
+    #else
+    length_block_candidates(T, num_ts, i, task->min, task->max, block_distances, &series->ts_shapelets[block_offset], NULL);
+    #endif
+    
+    free(block_distances);
+    free(length_distances);
+    #else
     Shapelet shapelet_candidate;
-    numeric_type *shapelet_distances;
-    // arguments passed via structure
-    Shapelet * ts_shapelets = ((Thread_args *) arg)->ts_shapelets;
-    uint16_t *shapelets_index = ((Thread_args *) arg)->shapelets_index;
-    uint16_t num_ts = ((Thread_args *) arg)->num_ts;
-    Timeseries *T = ((Thread_args *) arg)->T;
-    uint16_t i = ((Thread_args *) arg)->i;
-    pthread_mutex_t * mutex = ((Thread_args *) arg)->mutex;
-    uint16_t max = ((Thread_args *) arg)->max;
-    uint16_t min = ((Thread_args *) arg)->min;
-
+    // Reused by every candidate of this task
+    F_stat_accumulator quality;
+    uint32_t *match_windows = safe_alloc(num_ts * sizeof(*match_windows));
+    f_stat_accumulator_init(&quality, series->selection->num_classes);
+    memset(match_windows, 0, num_ts * sizeof(*match_windows));
+    #ifdef QUALITY_PRUNING
+    numeric_type quality_threshold;
+    uint64_t num_distances = 0;
+    Distance_bounds bounds;
+    distance_bounds_init(&bounds, num_ts, series->selection->num_classes, task->max);
+    #ifndef USE_STREAMING_TOP_K
+    // A threshold older than the one in place when T[i] is merged is still safe, since it only grows
+    pthread_mutex_lock(&series->selection->mutex);
+        quality_threshold = series->selection->quality_threshold;
+    pthread_mutex_unlock(&series->selection->mutex);
+    #endif
+    #endif
+    
     // For each length between min and max
-    for (int l = min; l <= max; l++){ 
-        num_shapelets = T->length - l + 1;    
+    for (int l = task->min; l <= task->max; l++){ 
+        #ifndef USE_STREAMING_TOP_K
+        const uint64_t offset = candidate_offset(T[i].length, series->min, l);
+        #endif
+        const uint32_t last_position = (task->last_position < T->length - l) ? task->last_position : T->length - l;
 
         // For each shapelet of the given length
-        for (int position = 0; position < num_shapelets; position++){
+        for (uint32_t position = task->first_position; position <= last_position; position++){
             shapelet_candidate = init_shapelet(&T[i], position, l);  // Assemble each shapelet on the fly, instead of keeping them in a matrix
-            shapelet_distances = safe_alloc(num_ts * sizeof(*shapelet_distances));
             
-            // Calculate distances from current shapelet candidate to each time series in T, 
+            // Calculate distances from current shapelet candidate to each time series in T, normalizing it only once
+            shapelet_normalize(&shapelet_candidate);
+            #ifdef QUALITY_PRUNING
+            #ifdef USE_STREAMING_TOP_K
+            // The worker's own k best: a candidate it rejects can't be among the k best of the merged workers
+            quality_threshold = top_k_threshold(&series->selection->thread_top_k[worker]);
+            #endif
+            if (!bounded_candidate_quality(&series->selection->pruning, &bounds, &shapelet_candidate, T, match_windows, quality_threshold, &quality, &num_distances)){
+                shapelet_free_normalized(&shapelet_candidate);
+                abandon_candidate(&shapelet_candidate);
+                #ifndef USE_STREAMING_TOP_K
+                series->ts_shapelets[offset + position] = shapelet_candidate;
+                #endif
+                continue;
+            }
+            #else
+            f_stat_accumulator_reset(&quality);
             for (int j = 0; j < num_ts; j++)
-                shapelet_distances[j] = shapelet_ts_distance(&shapelet_candidate, &T[j]);   
+                f_stat_accumulator_add(&quality, warm_candidate_distance(&shapelet_candidate, &T[j], &match_windows[j]), T[j].class);
+            #endif
+            shapelet_free_normalized(&shapelet_candidate);
 
             // F-Statistic as shapelet quality measure
-            shapelet_candidate.quality = bin_f_statistic(shapelet_distances, T, num_ts);
+            shapelet_candidate.quality = f_stat_accumulator_value(&quality);
             
-            free(shapelet_distances);   //shapelet_distances is only used to measure quality
-            // Store every shapelet of T[i] with its quality measure and length in the format [quality, length, shapelet] with shapelet = [s1, s2, ..., sl] 
-            pthread_mutex_lock(mutex);
-                ts_shapelets[*shapelets_index] = shapelet_candidate;    //ts_shapelts and index are shared between threads
-                *shapelets_index = *shapelets_index + 1;
-            pthread_mutex_unlock(mutex);
+            #ifdef USE_STREAMING_TOP_K
+            top_k_insert(&series->selection->thread_top_k[worker], shapelet_candidate);
+            #else
+            // Store the candidate in its own slot, in the same order as the sequential selection
+            series->ts_shapelets[offset + position] = shapelet_candidate;
+            #endif
         }
     }    
-
-    pthread_exit(NULL);    
+    f_stat_accumulator_free(&quality);
+    free(match_windows);
+    #ifdef QUALITY_PRUNING
+    distance_bounds_free(&bounds);
+    __atomic_add_fetch(&series->selection->num_distances, num_distances, __ATOMIC_RELAXED);
+    #endif
+    #endif
+    
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    series->selection->thread_predicted_costs[worker] += task->predicted_cost;
+    series->selection->thread_measured_times[worker] += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    series->selection->thread_num_tasks[worker]++;
+    
+    // The last task of the time series to finish sorts its candidates and merges them
+    if (__atomic_sub_fetch(&series->num_pending_tasks, 1, __ATOMIC_ACQ_REL) == 0)
+        finalize_series(series);
 }
 
 
-//implements shapelet_cached_selection using multiple threads
+//implements shapelet_cached_selection using a persistent pool of threads
+// The candidates of every time series are split into tasks of (lengths, positions) blocks of balanced predicted cost, submitted 
+// for up to POOL_SERIES_IN_FLIGHT time series at once, so that workers never wait for the sort and merge of a time series
 Shapelet *multi_thread_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, const uint16_t min, const uint16_t max, uint16_t k, const uint16_t max_num_threads){
-    uint16_t shapelets_index;
-    uint32_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
-    uint32_t num_merged_shapelets; //total number of shapelets to be merged after removing self similars
-    Shapelet *k_shapelets, *ts_shapelets;
-
-    // thread spefic variables:
-    pthread_t * threads;
-    Thread_args * args;    // argument vector for each thread used
-    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER; // mutex to controll shared resources (shapelet_index)
-    uint16_t num_threads;       // actual number of threads used
-    uint16_t lengths_per_thread;
+    uint64_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
+    const uint16_t num_classes = dataset_num_classes(T, num_ts);
+    uint32_t num_tasks;
+    double total_predicted_cost = 0.0, total_measured_time = 0.0;
+    Shapelet *k_shapelets;
+    Thread_pool *pool;
+    Selection_state selection;
+    Series_candidates *series_array;
+    Candidate_task *task_plan;
+
     //checks to assert if the parameters are valid
     if (min > max){
         printf("Min greater than max");
@@ -506,11 +2144,12 @@ Shapelet *multi_thread_shapelet_cached_selection(Timeseries * T, uint16_t num_ts
     if(max_num_threads <= 0)
     {
         printf("Maximun number of threads must be greater than zero!\n");
+        exit(-1);
     }
 
-    if(num_ts <= 2)
+    if(num_classes < 2 || num_ts <= num_classes)
     {
-        printf("Number of time series must be greater than 2!");
+        printf("Number of time series must be greater than the number of classes, with at least 2 classes!");
         exit(-1);
     }
 
@@ -521,81 +2160,343 @@ Shapelet *multi_thread_shapelet_cached_selection(Timeseries * T, uint16_t num_ts
         exit(-1);
     }
 
-    // total number of threads created depends on max and min input
-    if(max - min <= max_num_threads){
-        num_threads = max - min + 1;        // we can use up to max - min + 1 threads in this application
-    }
-    else{
-        num_threads = max_num_threads;
-    }
-    //alocate threads and arguments
-    threads = safe_alloc(num_threads * sizeof(*threads));
-    args = safe_alloc(num_threads * sizeof(*args));
-
     // total number of shapelets in each T[i] 
-    total_num_shapelets = (min-max-1) * (max + min - 2*T->length - 2)/(2);
-    printf("Total number of shapelets for each time-series: %u\n", total_num_shapelets);
+    total_num_shapelets = candidate_offset(T->length, min, max + 1);
+    printf("Total number of shapelets for each time-series: %llu\n", (unsigned long long) total_num_shapelets);
 
-    lengths_per_thread = (max - min + 1) / num_threads;  // number of lengths each thread will calculated
+    // Every time series has the same length, so the same tasks
+    num_tasks = plan_candidate_tasks(T->length, num_ts, min, max, max_num_threads, NULL);
+    task_plan = safe_alloc(num_tasks * sizeof(*task_plan));
+    plan_candidate_tasks(T->length, num_ts, min, max, max_num_threads, task_plan);
+    
+    selection.k_shapelets = k_shapelets;
+    selection.k = k;
+    selection.next_merge = 0;
+    selection.num_in_flight = 0;
+    pthread_mutex_init(&selection.mutex, NULL);
+    pthread_cond_init(&selection.series_merged, NULL);
+    // Time series not submitted yet must not be seen as ready
+    series_array = safe_alloc(num_ts * sizeof(*series_array));
+    memset(series_array, 0, num_ts * sizeof(*series_array));
+    selection.series_array = series_array;
+    selection.num_ts = num_ts;
+    selection.num_classes = num_classes;
+    selection.thread_predicted_costs = safe_alloc(max_num_threads * sizeof(*selection.thread_predicted_costs));
+    selection.thread_measured_times = safe_alloc(max_num_threads * sizeof(*selection.thread_measured_times));
+    selection.thread_num_tasks = safe_alloc(max_num_threads * sizeof(*selection.thread_num_tasks));
+    memset(selection.thread_predicted_costs, 0, max_num_threads * sizeof(*selection.thread_predicted_costs));
+    memset(selection.thread_measured_times, 0, max_num_threads * sizeof(*selection.thread_measured_times));
+    memset(selection.thread_num_tasks, 0, max_num_threads * sizeof(*selection.thread_num_tasks));
+    #ifdef USE_STREAMING_TOP_K
+    selection.thread_top_k = safe_alloc(max_num_threads * sizeof(*selection.thread_top_k));
+    for (uint16_t t = 0; t < max_num_threads; t++)
+        top_k_init(&selection.thread_top_k[t], k);
+    #endif
+    #ifdef QUALITY_PRUNING
+    quality_pruning_init(&selection.pruning, T, num_ts, num_classes);
+    selection.quality_threshold = k_shapelets_threshold(k_shapelets, k);
+    selection.num_distances = 0;
+    #endif
+    pool = thread_pool_create(max_num_threads);
 
     // For each time-series T[i] in T
     for (int i = 0; i < num_ts; i++){
-        ts_shapelets = safe_alloc(total_num_shapelets * sizeof(*ts_shapelets));
-        shapelets_index = 0;
+        Series_candidates *series = &series_array[i];
+        
+        // Bound the memory held by the candidates of time series not merged yet
+        pthread_mutex_lock(&selection.mutex);
+            while (selection.num_in_flight >= POOL_SERIES_IN_FLIGHT)
+                pthread_cond_wait(&selection.series_merged, &selection.mutex);
+            selection.num_in_flight++;
+        pthread_mutex_unlock(&selection.mutex);
+        
+        series->selection = &selection;
+        series->T = T;
+        series->num_ts = num_ts;
+        series->i = i;
+        series->min = min;
+        series->max = max;
+        #ifdef USE_STREAMING_TOP_K
+        series->ts_shapelets = NULL;
+        #else
+        series->ts_shapelets = safe_alloc(total_num_shapelets * sizeof(*series->ts_shapelets));
+        #endif
+        series->total_num_shapelets = total_num_shapelets;
+        series->num_shapelets = 0;
+        series->tasks = safe_alloc(num_tasks * sizeof(*series->tasks));
+        memcpy(series->tasks, task_plan, num_tasks * sizeof(*series->tasks));
+        series->num_pending_tasks = num_tasks;
+        
+        printf("[TS %u]\n", i);
+        for (uint32_t t = 0; t < num_tasks; t++){
+            series->tasks[t].series = series;
+            thread_pool_submit(pool, task_shapelet_candidates, &series->tasks[t]);
+        }
+    }
+    
+    thread_pool_destroy(pool);
+    
+    #ifdef USE_STREAMING_TOP_K
+    // The k best candidates of the whole search are among the k best of each worker
+    Top_k top;
+    top_k_init(&top, k);
+    for (uint16_t t = 0; t < max_num_threads; t++){
+        top_k_merge(&top, &selection.thread_top_k[t]);
+        top_k_free(&selection.thread_top_k[t]);
+    }
+    top_k_to_array(&top, k_shapelets);
+    top_k_free(&top);
+    free(selection.thread_top_k);
+    #endif
+    
+    // Validation of the cost model: share of the predicted cost of each thread, converted to seconds, against its measured time
+    for (uint16_t t = 0; t < max_num_threads; t++){
+        total_predicted_cost += selection.thread_predicted_costs[t];
+        total_measured_time += selection.thread_measured_times[t];
+    }
+    printf("Load balance of %u tasks per time series (thread: tasks, predicted time, measured time)\n", num_tasks);
+    for (uint16_t t = 0; t < max_num_threads; t++){
+        printf("[Thread %u] %u, %.3fs, %.3fs\n", t, selection.thread_num_tasks[t], 
+               (total_predicted_cost > 0.0) ? selection.thread_predicted_costs[t] / total_predicted_cost * total_measured_time : 0.0,
+               selection.thread_measured_times[t]);
+    }
+    print_self_match_savings(total_num_shapelets, num_ts);
+    #ifdef QUALITY_PRUNING
+    quality_pruning_free(&selection.pruning);
+    print_pruning_savings(selection.num_distances, total_num_shapelets * num_ts * (num_ts - 1));
+    #endif
+    
+    pthread_mutex_destroy(&selection.mutex);
+    pthread_cond_destroy(&selection.series_merged);
+    free(selection.thread_predicted_costs);
+    free(selection.thread_measured_times);
+    free(selection.thread_num_tasks);
+    free(task_plan);
+    free(series_array);
+    return k_shapelets;
+}
 
-        // For each length between min and max
-        for (int tid = 0; tid < num_threads; tid++){
-            //set arguments for each running thread
-            args[tid].ts_shapelets = ts_shapelets;
-            args[tid].shapelets_index = &shapelets_index;
-            args[tid].num_ts = num_ts;
-            args[tid].T = T;
-            args[tid].i = i;
-            args[tid].mutex = &mutex;
-            // alocates a load to each thread, based on min and max length that the thread will compute
-            args[tid].min = min + tid*(lengths_per_thread);
-            if(tid == num_threads -1 ){
-                args[tid].max = max;        // last thread calculates all remaining lengths
-            }
-            else{
-                args[tid].max = args[tid].min + lengths_per_thread - 1;     //else calculate lenghts_per_thread lengths
+void candidate_tile_distances(const numeric_type *normalized_candidates, const uint32_t *candidate_orders, const numeric_type *ordered_candidates, 
+                              uint32_t length, uint32_t first_candidate, uint32_t end_candidate, 
+                              const Timeseries *T, uint16_t first_target, uint16_t end_target, uint16_t num_ts, 
+                              const Timeseries *source, numeric_type *distances){
+    // Window of each target where the scan of the next candidate starts, the candidates being consecutive positions
+    uint32_t *match_windows = scratch_alloc((end_target - first_target) * sizeof(*match_windows));
+    
+    memset(match_windows, 0, (end_target - first_target) * sizeof(*match_windows));
+    // Each candidate sweeps the targets of the tile, which stay cached from one candidate to the next
+    for (uint32_t c = first_candidate; c < end_candidate; c++){
+        const uint32_t *pivot_order = (candidate_orders != NULL) ? &candidate_orders[(size_t) c * length] : NULL;
+        const numeric_type *ordered_pivot_values = (ordered_candidates != NULL) ? &ordered_candidates[(size_t) c * length] : NULL;
+        
+        for (uint16_t j = first_target; j < end_target; j++){
+            uint32_t *match_window = &match_windows[j - first_target];
+            // The candidates of the table are the windows first_candidate... of their source series, where they match themselves
+            if (&T[j] == source){
+                distances[(size_t) c * num_ts + j] = 0;
+                continue;
             }
+            distances[(size_t) c * num_ts + j] = ordered_shapelet_ts_distance_profile((numeric_type *) &normalized_candidates[(size_t) c * length], 
+                                                                                      pivot_order, ordered_pivot_values, length, &T[j], match_window, NULL);
+            (*match_window)++;
+        }
+    }
+    scratch_release_from(match_windows);
+}
 
-            if( pthread_create(&threads[tid], NULL, task_shapelet_candidates, (void *) &args[tid]) ){
-                perror("Error creating thread\n");
-                exit(errno);
+
+void tiled_candidate_distances(const numeric_type *normalized_candidates, const uint32_t *candidate_orders, const numeric_type *ordered_candidates, 
+                               uint32_t num_candidates, uint32_t length, const Timeseries *T, uint16_t num_ts, Tile_sizes tiles, numeric_type *distances){
+    if (scratch_mark() == 0)
+        scratch_reserve(scratch_block_size(num_ts * sizeof(uint32_t)) + distance_scratch_size(length, T->length));
+    
+    for (uint32_t first_target = 0; first_target < num_ts; first_target += tiles.targets){
+        const uint16_t end_target = (first_target + tiles.targets < num_ts) ? first_target + tiles.targets : num_ts;
+        for (uint32_t first_candidate = 0; first_candidate < num_candidates; first_candidate += tiles.candidates){
+            const uint32_t end_candidate = (first_candidate + tiles.candidates < num_candidates) ? first_candidate + tiles.candidates : num_candidates;
+            candidate_tile_distances(normalized_candidates, candidate_orders, ordered_candidates, length, first_candidate, end_candidate, 
+                                     T, first_target, end_target, num_ts, NULL, distances);
+        }
+    }
+}
+
+
+Tile_sizes default_tile_sizes(const Timeseries *T, uint16_t num_ts){
+    Tile_sizes tiles;
+    size_t target_bytes = T->length * sizeof(*T->values);
+    
+    if (T->prefix_sums != NULL)
+        target_bytes += 2 * (T->length + 1) * sizeof(*T->prefix_sums);
+    tiles.candidates = TILE_CANDIDATES;
+    tiles.targets = (TILE_TARGET_BYTES / target_bytes < num_ts) ? TILE_TARGET_BYTES / target_bytes : num_ts;
+    if (tiles.targets == 0)
+        tiles.targets = 1;
+    return tiles;
+}
+
+
+Tile_sizes autotune_tile_sizes(const Timeseries *T, uint16_t num_ts, uint32_t length){
+    const uint32_t num_candidates = (T->length - length + 1 < TILE_TUNING_CANDIDATES) ? T->length - length + 1 : TILE_TUNING_CANDIDATES;
+    const uint32_t candidate_factors[] = {4, 1};                   // divisors of TILE_CANDIDATES
+    const uint32_t target_factors[] = {4, 2, 1};                   // divisors of the default number of targets, and the whole dataset
+    const Tile_sizes default_tiles = default_tile_sizes(T, num_ts);
+    Tile_sizes tiles, best_tiles = default_tiles;
+    double time, best_time = INFINITY;
+    numeric_type *normalized_candidates = safe_alloc((size_t) num_candidates * length * sizeof(*normalized_candidates));
+    numeric_type *distances = safe_alloc((size_t) num_candidates * num_ts * sizeof(*distances));
+    uint32_t *candidate_orders = NULL;
+    numeric_type *ordered_candidates = NULL;
+    
+    if (scratch_mark() == 0)
+        scratch_reserve(scratch_block_size(num_ts * sizeof(uint32_t)) + distance_scratch_size(length, T->length));
+    #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+    candidate_orders = safe_alloc((size_t) num_candidates * length * sizeof(*candidate_orders));
+    ordered_candidates = safe_alloc((size_t) num_candidates * length * sizeof(*ordered_candidates));
+    #endif
+    for (uint32_t c = 0; c < num_candidates; c++){
+        normalized_copy(&T->values[c], length, &normalized_candidates[(size_t) c * length]);
+        #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+        abandon_order(&normalized_candidates[(size_t) c * length], length, &candidate_orders[(size_t) c * length], &ordered_candidates[(size_t) c * length]);
+        #endif
+    }
+    
+    for (size_t a = 0; a < sizeof(candidate_factors) / sizeof(*candidate_factors); a++){
+        for (size_t b = 0; b <= sizeof(target_factors) / sizeof(*target_factors); b++){
+            tiles.candidates = TILE_CANDIDATES / candidate_factors[a];
+            tiles.targets = (b < sizeof(target_factors) / sizeof(*target_factors)) ? default_tiles.targets / target_factors[b] : num_ts;
+            if (tiles.targets == 0)
+                continue;
+            time = omp_get_wtime();
+            tiled_candidate_distances(normalized_candidates, candidate_orders, ordered_candidates, num_candidates, length, T, num_ts, tiles, distances);
+            time = omp_get_wtime() - time;
+            if (time < best_time){
+                best_time = time;
+                best_tiles = tiles;
             }
-        }  // Here all shapelets from T[i] should have been stored along with its quality measures in ts_shapelets                                                             
+        }
+    }
+    
+    free(normalized_candidates);
+    free(candidate_orders);
+    free(ordered_candidates);
+    free(distances);
+    return best_tiles;
+}
+
+
+#ifdef TARGET_PARALLELISM
+// Candidates of T[i] evaluated by (candidate, target) pairs: within each length, every pair is an independent task, so the 
+// parallelism is the number of positions times num_ts instead of the number of lengths
+// With USE_TILED_DISTANCES the tasks are tiles of candidates and targets instead of pairs
+// The candidates are stored in their ts_shapelets slots, or inserted in the Top_k of the thread with USE_STREAMING_TOP_K
+static void target_parallel_candidates(Timeseries *T, uint16_t num_ts, uint16_t i, uint16_t min, uint16_t max, uint16_t num_classes, 
+                                       Tile_sizes tiles, Shapelet *ts_shapelets, Top_k *thread_top_k){
+    const uint32_t max_num_positions = T->length - min + 1;
+    // Normalized candidates of the current length, [position][value], and their distances, [position][j]
+    numeric_type *normalized_candidates = safe_alloc((size_t) max_num_positions * max * sizeof(*normalized_candidates));
+    numeric_type *candidate_distances = safe_alloc((size_t) max_num_positions * num_ts * sizeof(*candidate_distances));
+    // Abandon orders of the candidates, in the same format, sorted once per candidate instead of once per pair
+    uint32_t *candidate_orders = NULL;
+    numeric_type *ordered_candidates = NULL;
+    #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+    candidate_orders = safe_alloc((size_t) max_num_positions * max * sizeof(*candidate_orders));
+    ordered_candidates = safe_alloc((size_t) max_num_positions * max * sizeof(*ordered_candidates));
+    #endif
+    
+    #pragma omp parallel
+    {
+        F_stat_accumulator quality;
+        f_stat_accumulator_init(&quality, num_classes);
+        // openMP threads are kept alive between regions, so their arenas are only allocated once
+        // (with the best match windows of a tile)
+        scratch_reserve(selection_scratch_size(T->length, max) + scratch_block_size(num_ts * sizeof(uint32_t)));
         
-        //join all executing threads
-        for(int tid = 0; tid < num_threads; tid++){
-            if( pthread_join(threads[tid], NULL) ){
-                perror("Error joining threads!\n");
-                exit(errno);
+        for (int l = min; l <= max; l++){
+            const int num_positions = T->length - l + 1;
+            
+            #pragma omp for
+            for (int position = 0; position < num_positions; position++){
+                normalized_copy(&T[i].values[position], l, &normalized_candidates[(size_t) position * l]);
+                #if defined(USE_REORDERED_ABANDON) && !defined(USE_FIXED)
+                abandon_order(&normalized_candidates[(size_t) position * l], l, &candidate_orders[(size_t) position * l], &ordered_candidates[(size_t) position * l]);
+                #endif
             }
-        }
             
-        // Sort shapelets by quality
-        qsort(ts_shapelets, (size_t) total_num_shapelets, sizeof(*ts_shapelets), compare_shapelets);
-        // Remove self similar shapelets
-        num_merged_shapelets = total_num_shapelets;
-        ts_shapelets = remove_self_similars(ts_shapelets, &num_merged_shapelets);
-        // Merge ts_shapelets with k_shapelets and keep only best k shapelets, destroying all total_num_shapelets in ts_shapelets
-        merge_shapelets(k_shapelets, k, ts_shapelets, num_merged_shapelets);
-        free(ts_shapelets);
+            #ifdef TILED_DISTANCES
+            // The candidate tiles of a target tile are consecutive tasks, so a thread often reuses the targets it has cached
+            const int num_target_tiles = (num_ts + tiles.targets - 1) / tiles.targets;
+            const int num_candidate_tiles = (num_positions + tiles.candidates - 1) / tiles.candidates;
+            #pragma omp for collapse(2) schedule(dynamic)
+            for (int target_tile = 0; target_tile < num_target_tiles; target_tile++){
+                for (int candidate_tile = 0; candidate_tile < num_candidate_tiles; candidate_tile++){
+                    const uint32_t first_candidate = candidate_tile * tiles.candidates, first_target = target_tile * tiles.targets;
+                    candidate_tile_distances(normalized_candidates, candidate_orders, ordered_candidates, l, first_candidate, 
+                                             (first_candidate + tiles.candidates < num_positions) ? first_candidate + tiles.candidates : num_positions, 
+                                             T, first_target, (first_target + tiles.targets < num_ts) ? first_target + tiles.targets : num_ts, 
+                                             num_ts, &T[i], candidate_distances);
+                }
+            }
+            #else
+            // Distances of neighbouring positions to the same target share the target cache lines
+            #pragma omp for collapse(2) schedule(dynamic, 16)
+            for (int position = 0; position < num_positions; position++){
+                for (int j = 0; j < num_ts; j++){
+                    const size_t offset = (size_t) position * l;
+                    uint32_t best_window = 0;
+                    
+                    candidate_distances[(size_t) position * num_ts + j] = (j == i) ? 0 : 
+                        ordered_shapelet_ts_distance_profile(&normalized_candidates[offset], (candidate_orders != NULL) ? &candidate_orders[offset] : NULL, 
+                                                             (ordered_candidates != NULL) ? &ordered_candidates[offset] : NULL, l, &T[j], &best_window, NULL);
+                }
+            }
+            #endif
+            
+            // The implicit barrier keeps the tables until every quality of this length is computed
+            #pragma omp for
+            for (int position = 0; position < num_positions; position++){
+                Shapelet shapelet_candidate = init_shapelet(&T[i], position, l);
+                const numeric_type *distances = &candidate_distances[(size_t) position * num_ts];
+                
+                f_stat_accumulator_reset(&quality);
+                for (int j = 0; j < num_ts; j++)
+                    f_stat_accumulator_add(&quality, distances[j], T[j].class);
+                shapelet_candidate.quality = f_stat_accumulator_value(&quality);
+                
+                #ifdef USE_STREAMING_TOP_K
+                top_k_insert(&thread_top_k[omp_get_thread_num()], shapelet_candidate);
+                #else
+                ts_shapelets[candidate_offset(T->length, min, l) + position] = shapelet_candidate;
+                #endif
+            }
+        }
+        f_stat_accumulator_free(&quality);
     }
-
-    free(threads);
-    free(args);
-    return k_shapelets;
+    
+    free(normalized_candidates);
+    free(candidate_orders);
+    free(ordered_candidates);
+    free(candidate_distances);
 }
+#endif
+
 
 // Multithred and SIMD aceleration using openMP
 Shapelet *omp_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k){
-    uint16_t shapelets_index;
-    uint32_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
-    uint32_t num_merged_shapelets; //total number of shapelets to be merged after removing self similars
-    Shapelet *k_shapelets, *ts_shapelets;
+    uint64_t total_num_shapelets; //total number of shapelets of a given timeseries length from given min and max shapelet lenght parameters
+    const uint16_t num_classes = dataset_num_classes(T, num_ts);
+    Shapelet *k_shapelets;
+    #ifdef USE_STREAMING_TOP_K
+    // k best candidates of each openMP thread, merged at the end
+    const int num_threads = omp_get_max_threads();
+    Top_k top, *thread_top_k;
+    #else
+    uint64_t num_merged_shapelets; //total number of shapelets to be merged after removing self similars
+    Shapelet *ts_shapelets;
+    #endif
+    #ifdef QUALITY_PRUNING
+    Quality_pruning pruning;
+    uint64_t num_distances = 0;         // distances actually computed
+    #endif
 
     //checks to assert if the parameters are valid
     if (min > max){
@@ -603,9 +2504,9 @@ Shapelet *omp_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_
         exit(-1);
     }
 
-    if(num_ts <= 2)
+    if(num_classes < 2 || num_ts <= num_classes)
     {
-        printf("Number of time series must be greater than 2");
+        printf("Number of time series must be greater than the number of classes, with at least 2 classes");
         exit(-1);
     }
 
@@ -617,41 +2518,142 @@ Shapelet *omp_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_
     }
 
     // total number of shapelets in each T[i] 
-    total_num_shapelets = (min-max-1) * (max + min - 2*T->length - 2)/(2);
-    printf("Total number of shapelets for each time-series: %u\n", total_num_shapelets);
+    total_num_shapelets = candidate_offset(T->length, min, max + 1);
+    printf("Total number of shapelets for each time-series: %llu\n", (unsigned long long) total_num_shapelets);
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    // Distances from every candidate to each time series, in the format [candidate][j]
+    numeric_type *batch_distances = safe_alloc((size_t) total_num_shapelets * num_ts * sizeof(*batch_distances));
+    #endif
+    #ifdef USE_STREAMING_TOP_K
+    thread_top_k = safe_alloc(num_threads * sizeof(*thread_top_k));
+    for (int t = 0; t < num_threads; t++)
+        top_k_init(&thread_top_k[t], k);
+    #endif
+    #ifdef QUALITY_PRUNING
+    quality_pruning_init(&pruning, T, num_ts, num_classes);
+    #endif
+    #ifdef TARGET_PARALLELISM
+    #if defined(TILED_DISTANCES) && defined(USE_TILE_AUTOTUNE)
+    const Tile_sizes tiles = autotune_tile_sizes(T, num_ts, min);
+    #else
+    const Tile_sizes tiles = default_tile_sizes(T, num_ts);
+    #endif
+    #ifdef TILED_DISTANCES
+    printf("Tiles of %u candidates by %u time series\n", tiles.candidates, tiles.targets);
+    #endif
+    #endif
     
     // For each time-series T[i] in T
     for (int i = 0; i < num_ts; i++){
+        #ifndef USE_STREAMING_TOP_K
         ts_shapelets = safe_alloc(total_num_shapelets * sizeof(*ts_shapelets));
-        shapelets_index = 0;
+        #endif
         printf("[TS %u]\n", i);
+        #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+        // Each target time series carries its own accumulators across all the lengths, so the parallelism is over T[j]
+        #pragma omp parallel
+        {
+            numeric_type *length_distances = safe_alloc(T->length * sizeof(*length_distances));
+            // openMP threads are kept alive between regions, so their arenas are only allocated once
+            scratch_reserve(selection_scratch_size(T->length, max));
+            #pragma omp for schedule(dynamic)
+            for (int j = 0; j < num_ts; j++)
+                length_block_distances(T, num_ts, i, j, min, max, batch_distances, length_distances);
+            free(length_distances);
+        }
+        #ifdef USE_STREAMING_TOP_K
+        length_block_candidates(T, num_ts, i, min, max, batch_distances, NULL, &thread_top_k[0]);
+        #else
+        length_block_candidates(T, num_ts, i, min, max, batch_distances, ts_shapelets, NULL);
+        #endif
+        #elif defined(TARGET_PARALLELISM)
+        #ifdef USE_STREAMING_TOP_K
+        target_parallel_candidates(T, num_ts, i, min, max, num_classes, tiles, NULL, thread_top_k);
+        #else
+        target_parallel_candidates(T, num_ts, i, min, max, num_classes, tiles, ts_shapelets, NULL);
+        #endif
+        #ifdef QUALITY_PRUNING
+        // Every distance but the self matches is computed, the candidates are not abandoned
+        num_distances += total_num_shapelets * (num_ts - 1);
+        #endif
+        #else
         // For each length between min and max
-        #pragma omp parallel for shared(shapelets_index, ts_shapelets)
+        #ifdef USE_STREAMING_TOP_K
+        #pragma omp parallel for
+        #else
+        #pragma omp parallel for shared(ts_shapelets)
+        #endif
         for (int l = min; l <= max; l++){ 
-            numeric_type *shapelet_distances = safe_alloc(num_ts * sizeof(*shapelet_distances));
+            F_stat_accumulator quality;
+            uint32_t *match_windows = safe_alloc(num_ts * sizeof(*match_windows));
+            f_stat_accumulator_init(&quality, num_classes);
+            memset(match_windows, 0, num_ts * sizeof(*match_windows));
+            // openMP threads are kept alive between regions, so their arenas are only allocated once
+            scratch_reserve(selection_scratch_size(T->length, max));
             long num_shapelets = T->length - l + 1;    
+            #ifdef QUALITY_PRUNING
+            uint64_t length_num_distances = 0;
+            Distance_bounds bounds;
+            distance_bounds_init(&bounds, num_ts, num_classes, l);
+            #ifdef USE_STREAMING_TOP_K
+            Top_k *top = &thread_top_k[omp_get_thread_num()];
+            numeric_type quality_threshold;
+            #else
+            // k_shapelets is only merged after the parallel region
+            const numeric_type quality_threshold = k_shapelets_threshold(k_shapelets, k);
+            #endif
+            #endif
+            #ifndef USE_STREAMING_TOP_K
+            // Each length owns the slots of its candidates, so no critical section is needed
+            const uint64_t offset = candidate_offset(T->length, min, l);
+            #endif
             // For each shapelet of the given length
             for (int position = 0; position < num_shapelets; position++){
                 Shapelet shapelet_candidate = init_shapelet(&T[i], position, l);               
-                // Calculate distances from current shapelet candidate to each time series in T, 
-                #pragma omp simd
+                // Calculate distances from current shapelet candidate to each time series in T, normalizing it only once
+                shapelet_normalize(&shapelet_candidate);
+                #ifdef QUALITY_PRUNING
+                #ifdef USE_STREAMING_TOP_K
+                quality_threshold = top_k_threshold(top);
+                #endif
+                if (!bounded_candidate_quality(&pruning, &bounds, &shapelet_candidate, T, match_windows, quality_threshold, &quality, &length_num_distances)){
+                    shapelet_free_normalized(&shapelet_candidate);
+                    abandon_candidate(&shapelet_candidate);
+                    #ifndef USE_STREAMING_TOP_K
+                    ts_shapelets[offset + position] = shapelet_candidate;
+                    #endif
+                    continue;
+                }
+                #else
+                f_stat_accumulator_reset(&quality);
                 for (int j = 0; j < num_ts; j++){
-                    shapelet_distances[j] = shapelet_ts_distance(&shapelet_candidate, &T[j]);   
+                    f_stat_accumulator_add(&quality, warm_candidate_distance(&shapelet_candidate, &T[j], &match_windows[j]), T[j].class);
                 }
+                #endif
+                shapelet_free_normalized(&shapelet_candidate);
 
                 // F-Statistic as shapelet quality measure
-                shapelet_candidate.quality = bin_f_statistic(shapelet_distances, T, num_ts);
+                shapelet_candidate.quality = f_stat_accumulator_value(&quality);
                 
+                #ifdef USE_STREAMING_TOP_K
+                top_k_insert(&thread_top_k[omp_get_thread_num()], shapelet_candidate);
+                #else
                 // Store every shapelet of T[i] with its quality measure and length in the format [quality, length, shapelet] with shapelet = [s1, s2, ..., sl] 
-                #pragma omp critical
-                {
-                ts_shapelets[shapelets_index] = shapelet_candidate;
-                shapelets_index++;
-                }
+                ts_shapelets[offset + position] = shapelet_candidate;
+                #endif
             } 
-            free(shapelet_distances);   
+            f_stat_accumulator_free(&quality);
+            free(match_windows);
+            #ifdef QUALITY_PRUNING
+            distance_bounds_free(&bounds);
+            #pragma omp atomic
+            num_distances += length_num_distances;
+            #endif
         }  // Here all shapelets from T[i] should have been stored together with its quality measures in ts_shapelets                                                             
+        #endif
         
+        #ifndef USE_STREAMING_TOP_K
         // Sort shapelets by quality
         qsort(ts_shapelets, (size_t) total_num_shapelets, sizeof(*ts_shapelets), compare_shapelets);
         // Remove self similar shapelets
@@ -660,8 +2662,28 @@ Shapelet *omp_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_
         // Merge ts_shapelets with k_shapelets and keep only best k shapelets, destroying all total_num_shapelets in ts_shapelets
         merge_shapelets(k_shapelets, k, ts_shapelets, num_merged_shapelets);
         free(ts_shapelets);
+        #endif
     }
     
+    #ifdef USE_STREAMING_TOP_K
+    top_k_init(&top, k);
+    for (int t = 0; t < num_threads; t++){
+        top_k_merge(&top, &thread_top_k[t]);
+        top_k_free(&thread_top_k[t]);
+    }
+    top_k_to_array(&top, k_shapelets);
+    top_k_free(&top);
+    free(thread_top_k);
+    #endif
+    print_self_match_savings(total_num_shapelets, num_ts);
+    #ifdef QUALITY_PRUNING
+    quality_pruning_free(&pruning);
+    print_pruning_savings(num_distances, total_num_shapelets * num_ts * (num_ts - 1));
+    #endif
+    
+    #if defined(USE_BATCHED_DISTANCES) && !defined(USE_FIXED) && !defined(USE_ABS)
+    free(batch_distances);
+    #endif
     return k_shapelets;
 }
 // Returns 1 if compared shapelets are self similar, 0 otherwise
@@ -675,48 +2697,103 @@ static inline int is_self_similar(const Shapelet s1, const Shapelet s2)
 }
 
 
-// Remove self similar shapelets (shapelets with overlapping indices), return pointer to new array and update num_shapelets
-Shapelet *remove_self_similars(Shapelet *ts_shapelets, uint32_t *num_shapelets){
-    int self_similar, num_removed_shapelets=0;
-    int ts_shapelets_size = *num_shapelets; //num_shapelets is updated later
-    Shapelet *new_list;     // list cointaining only non-self similar shapelets 
+// Positions of a time series covered by the shapelets kept so far, one bit per position
+typedef struct{
+    const Timeseries *ts;
+    uint64_t *bits;
+} Occupancy_bitmap;
 
-    //first, we find the inidices that will be removed and set their Ti to null
-    for(int i=1; i < ts_shapelets_size; i++)
-    {
-        self_similar = 0;
-        for(int j=0; j < i; j++) 
-        {
-            if(is_self_similar(ts_shapelets[i], ts_shapelets[j]))
-            {
-                self_similar = 1;
+
+// Returns 1 if any position from start to start + length - 1 is set, in O(length / 64)
+static int bitmap_any(const uint64_t *bits, uint32_t start, uint32_t length){
+    const uint32_t end = start + length;                                    // exclusive
+    const uint32_t first_word = start / 64, last_word = (end - 1) / 64;
+    
+    for (uint32_t w = first_word; w <= last_word; w++){
+        uint64_t mask = ~(uint64_t) 0;
+        if (w == first_word)
+            mask &= ~(uint64_t) 0 << (start % 64);
+        if (w == last_word && end % 64 != 0)
+            mask &= ~(uint64_t) 0 >> (64 - end % 64);
+        if (bits[w] & mask)
+            return 1;
+    }
+    return 0;
+}
+
+
+static void bitmap_set(uint64_t *bits, uint32_t start, uint32_t length){
+    const uint32_t end = start + length;
+    const uint32_t first_word = start / 64, last_word = (end - 1) / 64;
+    
+    for (uint32_t w = first_word; w <= last_word; w++){
+        uint64_t mask = ~(uint64_t) 0;
+        if (w == first_word)
+            mask &= ~(uint64_t) 0 << (start % 64);
+        if (w == last_word && end % 64 != 0)
+            mask &= ~(uint64_t) 0 >> (64 - end % 64);
+        bits[w] |= mask;
+    }
+}
+
+
+// Remove self similar shapelets (shapelets with overlapping indices), return pointer to new array and update num_shapelets
+// Two shapelets of the same time series overlap if and only if they share a position, so a shapelet is self similar to a 
+// better kept one exactly when one of its positions is already covered in the occupancy bitmap of its time series
+Shapelet *remove_self_similars(Shapelet *ts_shapelets, uint64_t *num_shapelets){
+    const uint64_t ts_shapelets_size = *num_shapelets;
+    uint64_t num_kept_shapelets = 0;
+    Occupancy_bitmap *bitmaps = NULL;       // one per source time series, usually a single one
+    uint32_t num_bitmaps = 0;
+    Shapelet *new_list;
+
+    for (uint64_t i = 0; i < ts_shapelets_size; i++){
+        const Shapelet candidate = ts_shapelets[i];
+        Occupancy_bitmap *bitmap = NULL;
+        
+        // Shapelets without time series are not kept
+        if (candidate.Ti == NULL)
+            continue;
+        
+        for (uint32_t b = 0; b < num_bitmaps; b++){
+            if (bitmaps[b].ts == candidate.Ti){
+                bitmap = &bitmaps[b];
                 break;
             }
         }
-        if(self_similar)
-        {
-            num_removed_shapelets++;
-            ts_shapelets[i].Ti = NULL;
+        if (bitmap == NULL){
+            const size_t num_words = (candidate.Ti->length + 63) / 64;
+            bitmaps = realloc(bitmaps, (num_bitmaps + 1) * sizeof(*bitmaps));
+            if (bitmaps == NULL){
+                perror("Error allocating occupancy bitmaps!\n");
+                exit(errno);
+            }
+            bitmap = &bitmaps[num_bitmaps++];
+            bitmap->ts = candidate.Ti;
+            bitmap->bits = safe_alloc(num_words * sizeof(*bitmap->bits));
+            memset(bitmap->bits, 0, num_words * sizeof(*bitmap->bits));
         }
+        
+        if (bitmap_any(bitmap->bits, candidate.start_position, candidate.length))
+            continue;
+        bitmap_set(bitmap->bits, candidate.start_position, candidate.length);
+        
+        // Kept shapelets are compacted in place, keeping their order
+        ts_shapelets[num_kept_shapelets++] = candidate;
     }
-
-    //create new ts_shapelets list
-    new_list = safe_alloc((ts_shapelets_size - num_removed_shapelets) * sizeof(Shapelet));
-
-    for(int i=0, j=0; i < ts_shapelets_size; i++)
-    {
-        if(ts_shapelets[i].Ti != NULL) 
-        {
-            new_list[j] = ts_shapelets[i];
-            j++;
-        }
+    
+    for (uint32_t b = 0; b < num_bitmaps; b++)
+        free(bitmaps[b].bits);
+    free(bitmaps);
+
+    // updates the shapelet size and shrinks the list
+    *num_shapelets = num_kept_shapelets;
+    new_list = realloc(ts_shapelets, (num_kept_shapelets > 0 ? num_kept_shapelets : 1) * sizeof(*new_list));
+    if (new_list == NULL){
+        perror("Error shrinking shapelet list!\n");
+        exit(errno);
     }
 
-    // updates the shapelet size
-    *num_shapelets = ts_shapelets_size - num_removed_shapelets;
-    // frees old list and points it to new one
-    free(ts_shapelets);
-
     return new_list;
 }
 
@@ -741,40 +2818,138 @@ void merge_shapelets(Shapelet* k_shapelets, uint16_t k, Shapelet* ts_shapelets,
 }
 
 
+void top_k_init(Top_k *top, uint16_t k){
+    top->shapelets = safe_alloc(k * sizeof(*top->shapelets));
+    top->k = k;
+    top->num_shapelets = 0;
+}
+
+
+void top_k_free(Top_k *top){
+    free(top->shapelets);
+    top->shapelets = NULL;
+    top->num_shapelets = 0;
+}
+
+
+// Streams a candidate into the k best shapelets, handling self similarity on insertion, in O(k)
+void top_k_insert(Top_k *top, Shapelet candidate){
+    uint16_t position, kept = 0;
+    
+    // Common case: not better than the k-th shapelet
+    if (top->k == 0 || (top->num_shapelets == top->k && candidate.quality <= top->shapelets[top->k - 1].quality))
+        return;
+    
+    // Rejected by an overlapping shapelet at least as good
+    for (uint16_t i = 0; i < top->num_shapelets && top->shapelets[i].quality >= candidate.quality; i++){
+        if (is_self_similar(top->shapelets[i], candidate))
+            return;
+    }
+    
+    // Evict the worse overlapping shapelets, keeping the order of the others
+    for (uint16_t i = 0; i < top->num_shapelets; i++){
+        if (top->shapelets[i].quality >= candidate.quality || !is_self_similar(top->shapelets[i], candidate))
+            top->shapelets[kept++] = top->shapelets[i];
+    }
+    top->num_shapelets = kept;
+    
+    // Drop the worst shapelet when full, then shift the worse ones to make room for the candidate
+    if (top->num_shapelets == top->k)
+        top->num_shapelets--;
+    position = top->num_shapelets;
+    while (position > 0 && top->shapelets[position - 1].quality < candidate.quality){
+        top->shapelets[position] = top->shapelets[position - 1];
+        position--;
+    }
+    top->shapelets[position] = candidate;
+    top->num_shapelets++;
+}
+
+
+void top_k_merge(Top_k *top, const Top_k *from){
+    for (uint16_t i = 0; i < from->num_shapelets; i++)
+        top_k_insert(top, from->shapelets[i]);
+}
+
+
+void top_k_to_array(const Top_k *top, Shapelet *k_shapelets){
+    memset(k_shapelets, 0, top->k * sizeof(*k_shapelets));
+    memcpy(k_shapelets, top->shapelets, top->num_shapelets * sizeof(*k_shapelets));
+}
+
+
 // Get value of a shapelet at a specific position 
-static inline numeric_type get_value(Shapelet *s, uint16_t j){
+static inline numeric_type get_value(Shapelet *s, uint32_t j){
     return s->Ti->values[s->start_position + j];
 }
 
 
 // Transform set of time-series based on the distances to a set o shapelets (the Transform of the ST)
-numeric_type **transform_dataset(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets){
+// Fills match_windows[i][j] with the best match windows when it is not NULL
+static numeric_type **shapelet_transform(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets, uint32_t **match_windows){
     numeric_type **transformed_data;
+    uint32_t best_window;
     
     transformed_data = safe_alloc(num_ts * sizeof(*transformed_data));
     for (uint16_t i = 0; i < num_ts; i++){
         transformed_data[i] = safe_alloc(num_shapelets * sizeof(**transformed_data));
     }
     
+    // Each shapelet is normalized once for the whole dataset
+    uint32_t max_length = 0, max_ts_length = 0;
+    size_t scratch_size = 0;
+    for (uint16_t j = 0; j < num_shapelets; j++){
+        scratch_size += scratch_block_size(shapelet_set[j].length * sizeof(numeric_type));
+        if (shapelet_set[j].length > max_length)
+            max_length = shapelet_set[j].length;
+    }
+    for (uint16_t i = 0; i < num_ts; i++){
+        if (T[i].length > max_ts_length)
+            max_ts_length = T[i].length;
+    }
+    if (scratch_mark() == 0)
+        scratch_reserve(scratch_size + distance_scratch_size(max_length, max_ts_length));
+    for (uint16_t j = 0; j < num_shapelets; j++)
+        shapelet_normalize(&shapelet_set[j]);
+    
     for (uint16_t i = 0; i < num_ts; i++){
         for (uint16_t j = 0; j < num_shapelets; j++){
-            transformed_data[i][j] = shapelet_ts_distance(&shapelet_set[j], &T[i]);
+            transformed_data[i][j] = shapelet_ts_distance_profile(&shapelet_set[j], &T[i], &best_window, NULL);
+            if (match_windows != NULL)
+                match_windows[i][j] = best_window;
         }
     }
     
+    for (uint16_t j = 0; j < num_shapelets; j++)
+        shapelet_free_normalized(&shapelet_set[j]);
+    
     return transformed_data;
 }
 
 
+numeric_type **transform_dataset(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets){
+    return shapelet_transform(T, num_ts, shapelet_set, num_shapelets, NULL);
+}
+
+
+numeric_type **transform_dataset_locations(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets, uint32_t ***match_windows){
+    *match_windows = safe_alloc(num_ts * sizeof(**match_windows));
+    for (uint16_t i = 0; i < num_ts; i++)
+        (*match_windows)[i] = safe_alloc(num_shapelets * sizeof(***match_windows));
+    
+    return shapelet_transform(T, num_ts, shapelet_set, num_shapelets, *match_windows);
+}
+
+
 // Print all positions of a certain shapelet as HEX
-void print_shapelet_elements(const numeric_type * shapelet_values, uint16_t shapelet_len){
+void print_shapelet_elements(const numeric_type * shapelet_values, uint32_t shapelet_len){
     // Union to represent float as unsigned without type punning
     union {
             float f;
             uint32_t u;
     } f2u;
     
-    for (uint16_t i = 0; i < shapelet_len; i++){
+    for (uint32_t i = 0; i < shapelet_len; i++){
         f2u.f = shapelet_values[i];
         printf("%08x ", f2u.u);
     }    
@@ -853,18 +3028,28 @@ void shapelet_set_to_files(Shapelet *shapelet_set, size_t num_shapelets, Timeser
     fclose(info_file_descriptor);
 }
    
+static int compare_labels(const void *label_1, const void *label_2){
+    const int32_t a = *(const int32_t *) label_1, b = *(const int32_t *) label_2;
+    
+    return (a > b) - (a < b);
+}
+
+
 // Read datasets into ts_array, loading number of time-series and time-series length from file header
 // Free all float arrays from ts_array and the ts_array itself 
 uint16_t read_dataset(char * filename, Timeseries **ts_array){
     FILE *file_descriptor;
     char *field;
-    uint16_t num_ts, ts_len;
+    uint16_t num_ts;
+    uint32_t ts_len;
     const uint16_t HEADER_BSIZE = 20;
     char header_buffer[HEADER_BSIZE];
-    uint16_t TS_BSIZE;
+    uint32_t TS_BSIZE;
     char *time_series_buffer;
     uint8_t ts_class;
     numeric_type *ts_values;
+    int32_t *labels, *distinct_labels;
+    uint16_t num_classes = 0;
     
     // Reads csv file and keeps its address at file_descriptor
     file_descriptor = fopen(filename, "r");
@@ -879,7 +3064,7 @@ uint16_t read_dataset(char * filename, Timeseries **ts_array){
         exit(errno);
     }
     num_ts = (uint16_t) atoi(strtok(header_buffer, " "));
-    ts_len = (uint16_t) atoi(strtok(NULL, " "));
+    ts_len = (uint32_t) atol(strtok(NULL, " "));
     
     // Allocate memory for time-series buffer using estimative of characters per time-series value
     TS_BSIZE = 15 * ts_len;
@@ -887,6 +3072,8 @@ uint16_t read_dataset(char * filename, Timeseries **ts_array){
         
     // Allocate memory for the time-series array that will hold the dataset
     *ts_array = safe_alloc(num_ts * sizeof(Timeseries));
+    labels = safe_alloc(num_ts * sizeof(*labels));
+    distinct_labels = safe_alloc(num_ts * sizeof(*distinct_labels));
     
     // Read all num_ts time-series from the dataset
     for(uint16_t i = 0; i < num_ts; i++){
@@ -911,14 +3098,14 @@ uint16_t read_dataset(char * filename, Timeseries **ts_array){
         #ifndef USE_FIXED
         ts_values[0] = atof(field);
         
-        for(uint16_t j = 1; j < ts_len; j++){
+        for(uint32_t j = 1; j < ts_len; j++){
             field = strtok(NULL, ",");
             ts_values[j] = atof(field);
         }
         
         #else
         ts_values[0] = fixedpt_fromfloat(atof(field));
-        for(uint16_t j = 1; j < ts_len; j++){
+        for(uint32_t j = 1; j < ts_len; j++){
             field = strtok(NULL, ",");
             ts_values[j] = fixedpt_fromfloat(atof(field));
         }
@@ -929,13 +3116,62 @@ uint16_t read_dataset(char * filename, Timeseries **ts_array){
             perror("\nError in class field: ");
             exit(errno);
         }
-        // Treats classes -1 and 2 (-1 in Wafer dataset, 2 in all the others) as 0
-        ts_class = (uint8_t) (atoi(field) == 1);
+        // Labels are kept aside, then numbered once they are all known
+        labels[i] = atoi(field);
         
-        (*ts_array)[i] = init_timeseries(ts_values, ts_class, ts_len);
+        (*ts_array)[i] = init_timeseries(ts_values, 0, ts_len);
+    }
+    
+    // Classes 0, 1, ... are the distinct labels by increasing value (-1 and 1 in the Wafer dataset, 1 and 2 in the others)
+    memcpy(distinct_labels, labels, num_ts * sizeof(*distinct_labels));
+    qsort(distinct_labels, num_ts, sizeof(*distinct_labels), compare_labels);
+    for (uint16_t i = 0; i < num_ts; i++){
+        if (num_classes == 0 || distinct_labels[i] != distinct_labels[num_classes - 1])
+            distinct_labels[num_classes++] = distinct_labels[i];
+    }
+    if (num_classes > 256){
+        printf("Error, the dataset has %u classes, at most 256 are supported\n", num_classes);
+        exit(-1);
+    }
+    for (uint16_t i = 0; i < num_ts; i++){
+        ts_class = (uint8_t) ((int32_t *) bsearch(&labels[i], distinct_labels, num_classes, sizeof(*distinct_labels), compare_labels) - distinct_labels);
+        (*ts_array)[i].class = ts_class;
     }
 
     free(time_series_buffer);
+    free(labels);
+    free(distinct_labels);
 
     return num_ts;
 }
+
+
+uint16_t dataset_num_classes(const Timeseries *T, uint16_t num_ts){
+    uint16_t num_classes = 0;
+    
+    for (uint16_t i = 0; i < num_ts; i++){
+        if (T[i].class + 1 > num_classes)
+            num_classes = T[i].class + 1;
+    }
+    return num_classes;
+}
+
+
+// Stable counting sort on the classes
+void sort_dataset_by_class(Timeseries *T, uint16_t num_ts){
+    const uint16_t num_classes = dataset_num_classes(T, num_ts);
+    Timeseries *sorted = safe_alloc(num_ts * sizeof(*sorted));
+    uint16_t *class_starts = safe_alloc((num_classes + 1) * sizeof(*class_starts));
+    
+    memset(class_starts, 0, (num_classes + 1) * sizeof(*class_starts));
+    for (uint16_t i = 0; i < num_ts; i++)
+        class_starts[T[i].class + 1]++;
+    for (uint16_t c = 0; c < num_classes; c++)
+        class_starts[c + 1] += class_starts[c];
+    for (uint16_t i = 0; i < num_ts; i++)
+        sorted[class_starts[T[i].class]++] = T[i];
+    memcpy(T, sorted, num_ts * sizeof(*T));
+    
+    free(sorted);
+    free(class_starts);
+}
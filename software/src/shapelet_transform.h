@@ -24,6 +24,9 @@
 #include <fenv.h>                           // change floating point rounding modes
 #include <pthread.h>                        // multi thread implementation
 #include "fixedptc.h"                       // Fixed point operations by Ivan Voras and Tim Hartrick 
+#ifdef SHAPELET_VARIANT
+#include "shapelet_variant_names.h"         // Symbols of a variant build (shapelet_variants.h)
+#endif
 
 #ifndef USE_FIXED
     typedef float numeric_type;
@@ -32,52 +35,233 @@
     typedef fixedpt numeric_type;
 #endif
 
+// Relative variance below which a window is considered a straight line when its statistics come from running sums (USE_SLIDING_STATS)
+#define SLIDING_STATS_EPSILON 1e-10
+
+// Number of elements accumulated between early abandon checks of the dot-product distance (USE_DOT_PRODUCT)
+#define DOT_PRODUCT_BLOCK 16
+
+// Memory cap of the per-series statistics index (see build_stats_index), series beyond it fall back to running sums
+#define STATS_INDEX_MAX_BYTES (256UL << 20)
+
+// Tasks of multi_thread_shapelet_cached_selection: tasks of equal predicted cost per thread and time series, 
+// and time series whose candidates are kept at once
+#define POOL_TASKS_PER_THREAD 4
+#define POOL_SERIES_IN_FLIGHT 4
+
+// Tiles of the candidate by target evaluation (USE_TILED_DISTANCES): bytes of the target time series of a tile, values and 
+// statistics index, sized to a private L2 cache, and candidates evaluated against them while they are cached
+// USE_TILE_AUTOTUNE times a few tile sizes around these on the host, each on TILE_TUNING_CANDIDATES candidates
+#define TILE_TARGET_BYTES (256UL << 10)
+#define TILE_CANDIDATES 32
+#define TILE_TUNING_CANDIDATES 64
+
+// Relative margin of the F-statistic bound of USE_QUALITY_PRUNING, covering the rounding of the single precision quality
+#define QUALITY_PRUNING_MARGIN 1e-3
+
+// Cost of the FFT-based distance profile (USE_MASS), per n log n of the padded series length, relative to an element of the 
+// windowed loop, calibrated against the early abandon loop (crossovers in how_to_compile.txt)
+#if defined(USE_SLIDING_STATS) || defined(USE_DOT_PRODUCT)
+    #define MASS_COST_FACTOR 10         // the windowed loop only visits the elements before early abandon
+#else
+    #define MASS_COST_FACTOR 1          // each window is copied and normalized before early abandon
+#endif
+
 
 // Time series structure
 typedef struct{
     uint8_t class;                      // The time series class is represented by a number
     numeric_type *values;    
-    uint16_t length;                    // Number of points in time series
+    uint32_t length;                    // Number of points in time series
+    double *prefix_sums;                // Statistics index: sums of the first i values, i = 0..length (NULL when not indexed)
+    double *prefix_squares_sums;        // Sums of the first i squared values
 } Timeseries;
 
+// Size of a tile of the candidate by target evaluation: number of candidates and of target time series
+typedef struct{
+    uint32_t candidates;
+    uint16_t targets;
+} Tile_sizes;
+
+// Normalized pivot with the quantities precomputed for the dot-product distance formulation
+typedef struct{
+    numeric_type *values;               // Normalized pivot values
+    uint32_t length;
+    double sum;                         // Sum of normalized values
+    double squares_sum;                 // Sum of squared normalized values
+    double *suffix_sums;                // Sum of the values from each block boundary to the end
+    double *suffix_norms;               // Norm of the values from each block boundary to the end
+} Dot_product_pivot;
+
+// Dot products of all the (position, window) pairs between two time series, together with the window sums, at a given length
+// Carried across consecutive lengths, since the accumulators of length l + 1 are the ones of length l plus one term
+typedef struct{
+    const Timeseries *pivot_ts;
+    const Timeseries *target_ts;
+    uint32_t length;                    // Current length
+    double *dots;                       // Dot products in the format [position][window], row stride target_ts->length
+    double *pivot_sums;                 // Sum and sum of squares of each window
+    double *pivot_squares_sums;
+    double *target_sums;
+    double *target_squares_sums;
+    numeric_type *pivot_offsets;        // Normalization statistics of each window at the current length
+    numeric_type *pivot_scales;
+    double *pivot_centered;
+    numeric_type *target_offsets;
+    numeric_type *target_scales;
+    double *target_centered;
+} Length_accumulators;
+
 // Shapelet structure
 typedef struct 
 {
-    uint16_t length;                    // Number of points contained in the shapelet
+    uint32_t length;                    // Number of points contained in the shapelet
     numeric_type quality;               // Quality measure value
     Timeseries *Ti;                     // Timeseries from which the shapelet was extracted
     
-    uint16_t start_position;            // Index position on timeseries window
+    uint32_t start_position;            // Index position on timeseries window
+    numeric_type *normalized_values;    // Cached normalized values (see shapelet_normalize), NULL when not cached
+    uint32_t *pivot_order;              // Cached abandon_order of the normalized values (USE_REORDERED_ABANDON), NULL otherwise
+    numeric_type *ordered_values;       // Normalized values permuted in that order
     
     //numeric_type *Ti;                   // Timeseries values window pointer
 } Shapelet;
 
+// Best shapelets found so far, sorted by decreasing quality, without self similar pairs (USE_STREAMING_TOP_K)
+typedef struct{
+    Shapelet *shapelets;
+    uint16_t k;                         // Capacity
+    uint16_t num_shapelets;
+} Top_k;
+
+// Running statistics of the distances from a candidate to the time series of each class, from which the F-statistic, 
+// or a bound of it, is obtained at any point without keeping the distances
+typedef struct{
+    uint16_t num_classes;
+    uint16_t *counts;                   // Distances added to each class
+    double *sums;
+    double *centered_squares_sums;      // Sums of the squared differences to the class means
+} F_stat_accumulator;
+
 // Allocates memory and checks for allocation error
 void *safe_alloc(size_t size);
 
 // Returns a timeseries structure of a given class 
-Timeseries init_timeseries(numeric_type * values, uint8_t class, uint16_t length);
+Timeseries init_timeseries(numeric_type * values, uint8_t class, uint32_t length);
+
+// Builds the prefix sums and prefix sums of squares of every time series, so that the statistics of any window are found in O(1)
+// Series are indexed in order until max_bytes is reached, the remaining ones keep computing running sums on demand
+// Returns the number of bytes used (FREE WITH free_stats_index)
+size_t build_stats_index(Timeseries *T, uint16_t num_ts, size_t max_bytes);
+void free_stats_index(Timeseries *T, uint16_t num_ts);
 
 // Returns a new shapelet of a given size in a given time-series position
-Shapelet init_shapelet(Timeseries *time_series, uint16_t shapelet_position, uint16_t shapelet_len);
+Shapelet init_shapelet(Timeseries *time_series, uint32_t shapelet_position, uint32_t shapelet_len);
+
+// Caches the normalized values of a shapelet, so that they are computed once for all the target time series, 
+// and with USE_REORDERED_ABANDON their abandon order
+// The values live in the scratch arena of the calling thread, and are released together with anything drawn after them
+// (FREE WITH shapelet_free_normalized BEFORE STORING OR COPYING THE SHAPELET)
+void shapelet_normalize(Shapelet *shapelet);
+void shapelet_free_normalized(Shapelet *shapelet);
+
+// Normalizes the values in place (z score or algebric, as shapelet_normalize)
+void normalize_values(numeric_type *values, uint32_t length);
+
+// Copies length values into normalized_values and normalizes them (z score or algebric, as shapelet_normalize)
+void normalized_copy(const numeric_type *values, uint32_t length, numeric_type *normalized_values);
 
 // Generic vector normalization based on vector absolute value
-void algebric_normalization(numeric_type *values, uint16_t length);
+void algebric_normalization(numeric_type *values, uint32_t length);
 
 // Z score vector normalization
-void zscore_normalization(numeric_type *values, uint16_t length);
+void zscore_normalization(numeric_type *values, uint32_t length);
 
 // Generic euclidean distance
-numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, uint16_t length, numeric_type current_minimum_distance);
+numeric_type euclidean_distance(numeric_type *pivot_values, numeric_type *target_values, uint32_t length, numeric_type current_minimum_distance);
+
+#ifndef USE_FIXED
+// Normalization statistics (normalized value = (value - offset) * scale) of a window from its sum and sum of squares, in O(1)
+void window_normalization_stats(double sum, double squares_sum, uint32_t length, numeric_type *offset, numeric_type *scale);
+
+// Sum and sum of squares of the window starting at i, from the statistics index of the series or, without index, by sliding 
+// the sums of the window at i - 1 (the windows must then be visited in order, starting at 0)
+void window_sums(const Timeseries *time_series, uint32_t i, uint32_t length, double *window_sum, double *window_squares_sum);
+
+// Euclidean distance between a normalized pivot and a raw target window, normalized on the fly
+numeric_type window_euclidean_distance(numeric_type *pivot_values, const numeric_type *target_values, uint32_t length, numeric_type offset, numeric_type scale, numeric_type current_minimum_distance);
+
+// Indices of a normalized pivot sorted by decreasing magnitude, and the pivot values permuted in that order (USE_REORDERED_ABANDON)
+void abandon_order(const numeric_type *normalized_values, uint32_t length, uint32_t *order, numeric_type *ordered_values);
 
-// Distance from a shapelet to an entire time-series
+// Same as window_euclidean_distance, with the early abandon loop visiting the elements in the order given by abandon_order
+numeric_type ordered_euclidean_distance(const numeric_type *ordered_pivot_values, const numeric_type *target_values, const uint32_t *order, uint32_t length, numeric_type offset, numeric_type scale, numeric_type current_minimum_distance);
+
+// Precomputes the quantities of a normalized pivot used by the dot-product distance (FREE WITH dot_product_pivot_free)
+void dot_product_pivot_init(Dot_product_pivot *pivot, numeric_type *normalized_values, uint32_t length);
+void dot_product_pivot_free(Dot_product_pivot *pivot);
+
+// Squared euclidean distance between a normalized pivot and a raw target window, computed from their dot product and the window sums
+numeric_type dot_product_distance(const Dot_product_pivot *pivot, const numeric_type *target_values, double window_sum, double window_squares_sum, numeric_type current_minimum_distance);
+
+// Returns 1 when the FFT-based distance profile (MASS) is expected to be cheaper than the windowed loop (used with USE_MASS)
+uint8_t mass_is_cheaper(uint32_t length, uint32_t ts_length);
+
+// Distances from a normalized pivot to every window of a time series, computed with FFTs in O(n log n) (MASS)
+// distance_profile must hold time_series->length - pivot->length + 1 elements
+void mass_distance_profile(const Dot_product_pivot *pivot, const Timeseries *time_series, numeric_type *distance_profile);
+#endif
+
+// Distance from a shapelet to an entire time-series (uses the cached normalized values when present)
 numeric_type shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series);
 
+// Same distance, also returning the window where the shapelet matches best in *best_window, and when distance_profile is not 
+// NULL the distance to every window in it (time_series->length - length + 1 elements allocated by the caller, computed 
+// without early abandon)
+numeric_type shapelet_ts_distance_profile(Shapelet *pivot_shapelet, const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile);
+
+// Distance from an already normalized pivot to an entire time-series
+// Temporaries are drawn from the scratch arena of the calling thread, which must hold distance_scratch_size bytes
+numeric_type normalized_shapelet_ts_distance(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series);
+
+// Same distance, scanning the windows from *best_window (clamped to the last window) outward, and returning in *best_window 
+// the window of the minimum: a window near the best match of a neighbouring candidate gives early abandon a tight bound
+// Series without statistics index are scanned from window 0 with USE_SLIDING_STATS or USE_DOT_PRODUCT
+numeric_type warm_normalized_shapelet_ts_distance(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series, uint32_t *best_window);
+
+// Same distance and best window, also writing the distance to every window into distance_profile when it is not NULL (see
+// shapelet_ts_distance_profile)
+numeric_type normalized_shapelet_ts_distance_profile(numeric_type *pivot_values, uint32_t length, const Timeseries *time_series, 
+                                                     uint32_t *best_window, numeric_type *distance_profile);
+
+// Same distance and best window from a pivot whose abandon order (abandon_order) was computed once by the caller, used by
+// the early abandon loop with USE_REORDERED_ABANDON. With NULL pivot_order and ordered_pivot_values, it is computed for this call
+numeric_type ordered_shapelet_ts_distance_profile(numeric_type *pivot_values, const uint32_t *pivot_order, const numeric_type *ordered_pivot_values, 
+                                                  uint32_t length, const Timeseries *time_series, uint32_t *best_window, numeric_type *distance_profile);
+
+// Scratch arena bytes needed by normalized_shapelet_ts_distance
+size_t distance_scratch_size(uint32_t length, uint32_t ts_length);
+
 // Normalization and distance from a shapelet to an entire time-series using dynamic programming algorithm proposed by (Chang, 2012)
 numeric_type dynamic_shapelet_ts_distance(Shapelet *pivot_shapelet, const Timeseries *time_series);
 
-// [HARDWARE-friendly, reducing memory transfer] Distances from all the "shapelet_len"-sized shapelets in a time series to another time series (FREE RETURNED POINTER AFTER USAGE)
-//numeric_type *length_wise_distances(Timeseries *pivot_ts, Timeseries *target_ts, uint16_t shapelet_len);
+#ifndef USE_FIXED
+// [HARDWARE-friendly, reducing memory transfer] Minimum distances from all the "shapelet_len"-sized shapelets in a time series to another time series
+// minimum_distances must hold pivot_ts->length - shapelet_len + 1 elements, one for each shapelet position (squared distances, 
+// computed by length_accumulators_distances from accumulators initialized at shapelet_len, in the scratch arena of the calling thread)
+void length_wise_distances(const Timeseries *pivot_ts, const Timeseries *target_ts, uint32_t shapelet_len, numeric_type *minimum_distances);
+
+// Length-incremental evaluation: accumulators are initialized at a length, then grown one point at a time in O(n^2)
+// (FREE WITH length_accumulators_free)
+// The accumulators are drawn from the scratch arena of the calling thread (length_accumulators_scratch_size bytes)
+void length_accumulators_init(Length_accumulators *acc, const Timeseries *pivot_ts, const Timeseries *target_ts, uint32_t length);
+void length_accumulators_grow(Length_accumulators *acc);
+void length_accumulators_free(Length_accumulators *acc);
+size_t length_accumulators_scratch_size(uint32_t pivot_ts_length, uint32_t target_ts_length);
+
+// Minimum distance of every pivot position against the target time series, at the current length of the accumulators
+void length_accumulators_distances(Length_accumulators *acc, numeric_type *minimum_distances);
+#endif
 
 // F-Statistic based on distance measures and associated classes
 //float f_statistic(float *measured_distances, uint8_t *ts_classes, uint16_t num_of_ts, uint8_t num_classes);
@@ -85,30 +269,88 @@ numeric_type dynamic_shapelet_ts_distance(Shapelet *pivot_shapelet, const Timese
 // Generic F-Statistic based on distance measures and associated binary classes
 numeric_type bin_f_statistic(numeric_type *measured_distances, Timeseries *ts_set, uint16_t num_of_ts);
 
+// Incremental F-statistic over num_classes classes: the distances of a candidate are added one at a time, in any order, 
+// as the time series are evaluated, or by runs of the same class (FREE WITH f_stat_accumulator_free)
+// The accumulator is reset for each candidate
+void f_stat_accumulator_init(F_stat_accumulator *acc, uint16_t num_classes);
+void f_stat_accumulator_reset(F_stat_accumulator *acc);
+void f_stat_accumulator_free(F_stat_accumulator *acc);
+void f_stat_accumulator_add(F_stat_accumulator *acc, numeric_type distance, uint8_t class);
+void f_stat_accumulator_add_class(F_stat_accumulator *acc, const numeric_type *distances, uint16_t count, uint8_t class);
+
+// F-statistic of the distances added so far: as computed by bin_f_statistic for two classes, the one-way ANOVA F-statistic otherwise
+numeric_type f_stat_accumulator_value(const F_stat_accumulator *acc);
+
+// Upper bound of the final F-statistic once class_sizes[c] distances have been added to each class c, knowing that the 
+// sum of the distances still to be added to class c lies between remaining_lower_sums[c] and remaining_upper_sums[c]
+double f_stat_accumulator_bound(const F_stat_accumulator *acc, const uint16_t *class_sizes, const double *remaining_lower_sums, const double *remaining_upper_sums);
+
+// Distances from the normalized candidates first_candidate to end_candidate - 1 of a table ([candidate][value], all of the 
+// same length) to the time series first_target to end_target - 1 of T, written to distances[candidate * num_ts + target]
+// Each scan starts at the best match of the previous candidate, the arena of the calling thread must hold the best match
+// windows of the targets (a uint32_t each) along with distance_scratch_size bytes
+// When the candidates are all the windows of the time series source of T, from the first one, their distances to it are 0 
+// without scanning (NULL otherwise)
+// candidate_orders and ordered_candidates are the abandon_order tables of the candidates, in the same format, with 
+// USE_REORDERED_ABANDON (NULL otherwise, or to compute them at every distance)
+void candidate_tile_distances(const numeric_type *normalized_candidates, const uint32_t *candidate_orders, const numeric_type *ordered_candidates, 
+                              uint32_t length, uint32_t first_candidate, uint32_t end_candidate, 
+                              const Timeseries *T, uint16_t first_target, uint16_t end_target, uint16_t num_ts, 
+                              const Timeseries *source, numeric_type *distances);
+
+// Distances from every candidate of the table to every time series of T, tile by tile, in the format [candidate][target]
+void tiled_candidate_distances(const numeric_type *normalized_candidates, const uint32_t *candidate_orders, const numeric_type *ordered_candidates, 
+                               uint32_t num_candidates, uint32_t length, const Timeseries *T, uint16_t num_ts, Tile_sizes tiles, numeric_type *distances);
+
+// Tile sizes from TILE_TARGET_BYTES and TILE_CANDIDATES for the time series of T
+Tile_sizes default_tile_sizes(const Timeseries *T, uint16_t num_ts);
+
+// Times tiled_candidate_distances on candidates of T[0] of the given length with tile sizes around the default ones, 
+// and returns the fastest on this host
+Tile_sizes autotune_tile_sizes(const Timeseries *T, uint16_t num_ts, uint32_t length);
+
 // SHAPELET CACHED SELECTION (from algorithm 3 in "Classification of time series by shapelet transformation", Hills et al., 2013)
 // Given a set T of time series attatched to labels, extract shapelets exhaustively from min to max lengths, keeping only the k best shapelets according to some criteria 
 // (FREE RETURNED SHAPELET SET AFTER USAGE)
 Shapelet *shapelet_cached_selection(Timeseries * T, uint16_t num_of_ts, uint16_t min, uint16_t max, uint16_t k);
 
-//implements shapelet_cached_selection with multiple threads
-// the number of threads is the maximum threads that may be created 
-// however, if min + max < num_threads, fewer threads than expected will be used
+//implements shapelet_cached_selection with a persistent pool of num_threads threads (thread_pool.h)
+// candidates are evaluated in (lengths, positions) blocks taken across several time series at once, with the same result as the sequential version
 Shapelet *multi_thread_shapelet_cached_selection(Timeseries * T, uint16_t num_of_ts, const uint16_t min, const uint16_t max, uint16_t k, const uint16_t num_threads);
 
 // Multithred and SIMD aceleration using openMP
 Shapelet *omp_shapelet_cached_selection(Timeseries * T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k);
 
 // Remove self similar shapelets (shapelets with overlapping indices)
-Shapelet *remove_self_similars(Shapelet *ts_shapelets, uint32_t *num_shapelets);
+Shapelet *remove_self_similars(Shapelet *ts_shapelets, uint64_t *num_shapelets);
    
 // Merge ts_shapelets with k_shapelets and keep only best k shapelets
 void merge_shapelets(Shapelet* k_shapelets, uint16_t k, Shapelet* ts_shapelets, uint64_t ts_num_shapelets);
 
+// Bounded set of the k best shapelets, into which candidates are streamed as they are scored (FREE WITH top_k_free)
+// A candidate is rejected when it is not better than the k-th shapelet, or when it overlaps a kept shapelet at least as good.
+// Otherwise it evicts the worse shapelets it overlaps and takes its place in the order. Unlike sorting all the candidates and 
+// then removing self similars, a shapelet rejected because of a kept one is not brought back when that one is evicted later, 
+// so the selected set may differ when self similar candidates cascade
+void top_k_init(Top_k *top, uint16_t k);
+void top_k_free(Top_k *top);
+void top_k_insert(Top_k *top, Shapelet candidate);
+
+// Inserts every shapelet of from into top
+void top_k_merge(Top_k *top, const Top_k *from);
+
+// Copies the shapelets of top into k_shapelets (k elements, the missing ones zeroed)
+void top_k_to_array(const Top_k *top, Shapelet *k_shapelets);
+
 // Transform set of time-series based on the distances to a set o shapelets (the Transform of the ST)
 numeric_type **transform_dataset(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets);
 
+// Same transform, with the location features in the same pass: (*match_windows)[i][j] is the window of T[i] where shapelet j
+// matches best (FREE EACH (*match_windows)[i] AND *match_windows, AS THE TRANSFORMED DATA)
+numeric_type **transform_dataset_locations(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets, uint32_t ***match_windows);
+
 // Print all positions of a certain shapelet as HEX
-void print_shapelet_elements(const numeric_type * shapelet_values, uint16_t shapelet_len);
+void print_shapelet_elements(const numeric_type * shapelet_values, uint32_t shapelet_len);
 
 // Print all shapelets in a shapelet array
 void print_shapelets_ids(Shapelet * S, uint16_t num_shapelets, Timeseries *T);
@@ -117,7 +359,15 @@ void print_shapelets_ids(Shapelet * S, uint16_t num_shapelets, Timeseries *T);
 void shapelet_set_to_files(Shapelet *shapelet_set, size_t num_shapelets, Timeseries *T, const char * filename);
 
 // Read datasets into ts_array, loading number of time-series and time-series length from file header
+// The labels of the last column are numbered 0, 1, ..., by increasing label value (up to 256 classes)
 // Free all float arrays from ts_array and the ts_array itself 
 uint16_t read_dataset(char * filename, Timeseries **ts_array);
 
+// Number of classes of a dataset read by read_dataset (largest class plus one)
+uint16_t dataset_num_classes(const Timeseries *T, uint16_t num_ts);
+
+// Reorders the dataset by increasing class, keeping the order of the time series within a class, so that the distances to the 
+// time series of each class are contiguous in the selection functions
+void sort_dataset_by_class(Timeseries *T, uint16_t num_ts);
+
 #endif
\ No newline at end of file
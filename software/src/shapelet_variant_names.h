@@ -0,0 +1,104 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _SHAPELET_VARIANT_NAMES_H
+#define _SHAPELET_VARIANT_NAMES_H
+
+// Included by shapelet_transform.h when shapelet_transform.c is compiled as one of the variants of shapelet_variants.h 
+// (-DSHAPELET_VARIANT=zscore_pow, ...): every external symbol of shapelet_transform.c gets the _<variant> suffix, 
+// so all the variants link into the same binary next to the default shapelet_transform.o. The same goes for profiling_aux.c,
+// built once per variant by the prediction makefiles. A function added to either file must be added here too
+
+#define VARIANT_CONCAT(name, variant) name##_##variant
+#define VARIANT_EXPAND(name, variant) VARIANT_CONCAT(name, variant)
+#define VARIANT_SYMBOL(name) VARIANT_EXPAND(name, SHAPELET_VARIANT)
+
+#define abandon_order VARIANT_SYMBOL(abandon_order)
+#define algebric_normalization VARIANT_SYMBOL(algebric_normalization)
+#define autotune_tile_sizes VARIANT_SYMBOL(autotune_tile_sizes)
+#define bin_f_statistic VARIANT_SYMBOL(bin_f_statistic)
+#define build_stats_index VARIANT_SYMBOL(build_stats_index)
+#define candidate_tile_distances VARIANT_SYMBOL(candidate_tile_distances)
+#define dataset_num_classes VARIANT_SYMBOL(dataset_num_classes)
+#define default_tile_sizes VARIANT_SYMBOL(default_tile_sizes)
+#define distance_scratch_size VARIANT_SYMBOL(distance_scratch_size)
+#define dot_product_distance VARIANT_SYMBOL(dot_product_distance)
+#define dot_product_pivot_free VARIANT_SYMBOL(dot_product_pivot_free)
+#define dot_product_pivot_init VARIANT_SYMBOL(dot_product_pivot_init)
+#define dynamic_shapelet_ts_distance VARIANT_SYMBOL(dynamic_shapelet_ts_distance)
+#define euclidean_distance VARIANT_SYMBOL(euclidean_distance)
+#define f_stat_accumulator_add VARIANT_SYMBOL(f_stat_accumulator_add)
+#define f_stat_accumulator_add_class VARIANT_SYMBOL(f_stat_accumulator_add_class)
+#define f_stat_accumulator_bound VARIANT_SYMBOL(f_stat_accumulator_bound)
+#define f_stat_accumulator_free VARIANT_SYMBOL(f_stat_accumulator_free)
+#define f_stat_accumulator_init VARIANT_SYMBOL(f_stat_accumulator_init)
+#define f_stat_accumulator_reset VARIANT_SYMBOL(f_stat_accumulator_reset)
+#define f_stat_accumulator_value VARIANT_SYMBOL(f_stat_accumulator_value)
+#define free_stats_index VARIANT_SYMBOL(free_stats_index)
+#define init_shapelet VARIANT_SYMBOL(init_shapelet)
+#define init_timeseries VARIANT_SYMBOL(init_timeseries)
+#define length_accumulators_distances VARIANT_SYMBOL(length_accumulators_distances)
+#define length_accumulators_free VARIANT_SYMBOL(length_accumulators_free)
+#define length_accumulators_grow VARIANT_SYMBOL(length_accumulators_grow)
+#define length_accumulators_init VARIANT_SYMBOL(length_accumulators_init)
+#define length_accumulators_scratch_size VARIANT_SYMBOL(length_accumulators_scratch_size)
+#define length_wise_distances VARIANT_SYMBOL(length_wise_distances)
+#define mass_distance_profile VARIANT_SYMBOL(mass_distance_profile)
+#define mass_is_cheaper VARIANT_SYMBOL(mass_is_cheaper)
+#define merge_shapelets VARIANT_SYMBOL(merge_shapelets)
+#define multi_thread_shapelet_cached_selection VARIANT_SYMBOL(multi_thread_shapelet_cached_selection)
+#define normalize_values VARIANT_SYMBOL(normalize_values)
+#define normalized_copy VARIANT_SYMBOL(normalized_copy)
+#define normalized_shapelet_ts_distance VARIANT_SYMBOL(normalized_shapelet_ts_distance)
+#define normalized_shapelet_ts_distance_profile VARIANT_SYMBOL(normalized_shapelet_ts_distance_profile)
+#define omp_shapelet_cached_selection VARIANT_SYMBOL(omp_shapelet_cached_selection)
+#define ordered_shapelet_ts_distance_profile VARIANT_SYMBOL(ordered_shapelet_ts_distance_profile)
+#define ordered_euclidean_distance VARIANT_SYMBOL(ordered_euclidean_distance)
+#define print_shapelet_elements VARIANT_SYMBOL(print_shapelet_elements)
+#define print_shapelets_ids VARIANT_SYMBOL(print_shapelets_ids)
+#define read_dataset VARIANT_SYMBOL(read_dataset)
+#define remove_self_similars VARIANT_SYMBOL(remove_self_similars)
+#define safe_alloc VARIANT_SYMBOL(safe_alloc)
+#define shapelet_cached_selection VARIANT_SYMBOL(shapelet_cached_selection)
+#define shapelet_free_normalized VARIANT_SYMBOL(shapelet_free_normalized)
+#define shapelet_normalize VARIANT_SYMBOL(shapelet_normalize)
+#define shapelet_set_to_files VARIANT_SYMBOL(shapelet_set_to_files)
+#define shapelet_ts_distance VARIANT_SYMBOL(shapelet_ts_distance)
+#define shapelet_ts_distance_profile VARIANT_SYMBOL(shapelet_ts_distance_profile)
+#define sort_dataset_by_class VARIANT_SYMBOL(sort_dataset_by_class)
+#define tiled_candidate_distances VARIANT_SYMBOL(tiled_candidate_distances)
+#define top_k_free VARIANT_SYMBOL(top_k_free)
+#define top_k_init VARIANT_SYMBOL(top_k_init)
+#define top_k_insert VARIANT_SYMBOL(top_k_insert)
+#define top_k_merge VARIANT_SYMBOL(top_k_merge)
+#define top_k_to_array VARIANT_SYMBOL(top_k_to_array)
+#define transform_dataset VARIANT_SYMBOL(transform_dataset)
+#define transform_dataset_locations VARIANT_SYMBOL(transform_dataset_locations)
+#define warm_normalized_shapelet_ts_distance VARIANT_SYMBOL(warm_normalized_shapelet_ts_distance)
+#define window_euclidean_distance VARIANT_SYMBOL(window_euclidean_distance)
+#define window_normalization_stats VARIANT_SYMBOL(window_normalization_stats)
+#define window_sums VARIANT_SYMBOL(window_sums)
+#define zscore_normalization VARIANT_SYMBOL(zscore_normalization)
+
+// profiling_aux.c
+#define comp_mean_std VARIANT_SYMBOL(comp_mean_std)
+#define print_float_array VARIANT_SYMBOL(print_float_array)
+#define profiling_init_shapelet VARIANT_SYMBOL(profiling_init_shapelet)
+#define profiling_shapelet_ts_distance VARIANT_SYMBOL(profiling_shapelet_ts_distance)
+#define profiling_shapelet_ts_distance_profile VARIANT_SYMBOL(profiling_shapelet_ts_distance_profile)
+#define profiling_transform_dataset VARIANT_SYMBOL(profiling_transform_dataset)
+#define profiling_transform_dataset_locations VARIANT_SYMBOL(profiling_transform_dataset_locations)
+#define read_shapelets VARIANT_SYMBOL(read_shapelets)
+
+#endif
@@ -0,0 +1,143 @@
+// Copyright GMicro UFSM 2020.
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "shapelet_variants.h"
+
+// Functions of each variant build (shapelet_variant_names.h)
+#define DECLARE_VARIANT(variant) \
+    void normalize_values_##variant(numeric_type *values, uint32_t length); \
+    Shapelet *shapelet_cached_selection_##variant(Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, uint16_t k); \
+    Shapelet *multi_thread_shapelet_cached_selection_##variant(Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, uint16_t k, uint16_t num_threads); \
+    Shapelet *omp_shapelet_cached_selection_##variant(Timeseries *T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k); \
+    numeric_type shapelet_ts_distance_##variant(Shapelet *pivot_shapelet, const Timeseries *time_series); \
+    numeric_type **transform_dataset_##variant(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets); \
+    numeric_type **transform_dataset_locations_##variant(Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets, uint32_t ***match_windows);
+SHAPELET_VARIANTS(DECLARE_VARIANT)
+
+typedef struct{
+    const char *name;
+    void (*normalize)(numeric_type *, uint32_t);
+    Shapelet *(*cached_selection)(Timeseries *, uint16_t, uint16_t, uint16_t, uint16_t);
+    Shapelet *(*multi_thread_cached_selection)(Timeseries *, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t);
+    Shapelet *(*omp_cached_selection)(Timeseries *, uint16_t, uint16_t, uint16_t, uint16_t);
+    numeric_type (*ts_distance)(Shapelet *, const Timeseries *);
+    numeric_type **(*transform)(Timeseries *, uint16_t, Shapelet *, uint16_t);
+    numeric_type **(*transform_locations)(Timeseries *, uint16_t, Shapelet *, uint16_t, uint32_t ***);
+} Shapelet_variant;
+
+#define VARIANT_ENTRY(variant) \
+    {#variant, normalize_values_##variant, shapelet_cached_selection_##variant, multi_thread_shapelet_cached_selection_##variant, omp_shapelet_cached_selection_##variant, \
+     shapelet_ts_distance_##variant, transform_dataset_##variant, transform_dataset_locations_##variant},
+static const Shapelet_variant variants[] = {SHAPELET_VARIANTS(VARIANT_ENTRY)};
+
+#define NUM_DISTANCES 2
+
+
+uint8_t shapelet_variant_index(const Shapelet_config *config){
+    if (config->normalization > NORMALIZATION_ZSCORE_EXPECTED || config->distance > DISTANCE_ABS){
+        printf("Error, unknown normalization or distance in shapelet config\n");
+        exit(-1);
+    }
+    #ifdef USE_FIXED
+    if (config->normalization != NORMALIZATION_ALGEBRIC || config->distance != DISTANCE_POW){
+        printf("Error, only algebric_pow is defined in fixed point representation\n");
+        exit(-1);
+    }
+    #endif
+    
+    return config->normalization * NUM_DISTANCES + config->distance;
+}
+
+
+static inline const Shapelet_variant *config_variant(const Shapelet_config *config){
+    return &variants[shapelet_variant_index(config)];
+}
+
+
+Shapelet_config default_shapelet_config(void){
+    Shapelet_config config;
+    
+    #ifdef USE_ZSCORE
+    #ifdef USE_EXPECTED_VALUE
+    config.normalization = NORMALIZATION_ZSCORE_EXPECTED;
+    #else
+    config.normalization = NORMALIZATION_ZSCORE;
+    #endif
+    #else
+    config.normalization = NORMALIZATION_ALGEBRIC;
+    #endif
+    
+    #ifdef USE_ABS
+    config.distance = DISTANCE_ABS;
+    #else
+    config.distance = DISTANCE_POW;
+    #endif
+    
+    return config;
+}
+
+
+int parse_shapelet_config(const char *name, Shapelet_config *config){
+    for (size_t i = 0; i < sizeof(variants) / sizeof(*variants); i++){
+        if (strcmp(name, variants[i].name) == 0){
+            config->normalization = (Normalization) (i / NUM_DISTANCES);
+            config->distance = (Distance_function) (i % NUM_DISTANCES);
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+
+const char *shapelet_config_name(const Shapelet_config *config){
+    return config_variant(config)->name;
+}
+
+
+void config_normalize_values(const Shapelet_config *config, numeric_type *values, uint32_t length){
+    config_variant(config)->normalize(values, length);
+}
+
+
+Shapelet *config_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, uint16_t k){
+    return config_variant(config)->cached_selection(T, num_of_ts, min, max, k);
+}
+
+
+Shapelet *config_multi_thread_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, 
+                                                        uint16_t k, uint16_t num_threads){
+    return config_variant(config)->multi_thread_cached_selection(T, num_of_ts, min, max, k, num_threads);
+}
+
+
+Shapelet *config_omp_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k){
+    return config_variant(config)->omp_cached_selection(T, num_ts, min, max, k);
+}
+
+
+numeric_type config_shapelet_ts_distance(const Shapelet_config *config, Shapelet *pivot_shapelet, const Timeseries *time_series){
+    return config_variant(config)->ts_distance(pivot_shapelet, time_series);
+}
+
+
+numeric_type **config_transform_dataset(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets){
+    return config_variant(config)->transform(T, num_ts, shapelet_set, num_shapelets);
+}
+
+
+numeric_type **config_transform_dataset_locations(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, 
+                                                  uint16_t num_shapelets, uint32_t ***match_windows){
+    return config_variant(config)->transform_locations(T, num_ts, shapelet_set, num_shapelets, match_windows);
+}
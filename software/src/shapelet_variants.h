@@ -0,0 +1,71 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _SHAPELET_VARIANTS_H
+#define _SHAPELET_VARIANTS_H
+
+#include "shapelet_transform.h"
+
+// Normalization and distance of the shapelet transform chosen at runtime, instead of by USE_ZSCORE, USE_EXPECTED_VALUE and USE_ABS
+// Each combination (variant) is a copy of shapelet_transform.c compiled with its own defines and suffixed symbols 
+// (SHAPELET_VARIANT, see makefile_search.mk), so its kernels are as specialized as in a build of that single configuration,
+// and the config only selects which copy is called. USE_FIXED changes numeric_type and remains a compile time choice,
+// the other defines of the build apply to every variant
+
+typedef enum{
+    NORMALIZATION_ALGEBRIC,             // algebric_normalization
+    NORMALIZATION_ZSCORE,               // zscore_normalization with the sample standard deviation
+    NORMALIZATION_ZSCORE_EXPECTED       // zscore_normalization with the population standard deviation (USE_EXPECTED_VALUE)
+} Normalization;
+
+typedef enum{
+    DISTANCE_POW,                       // Sum of squared differences
+    DISTANCE_ABS                        // Sum of absolute differences (USE_ABS)
+} Distance_function;
+
+typedef struct{
+    Normalization normalization;
+    Distance_function distance;
+} Shapelet_config;
+
+// Variants built by the makefiles (VARIANTS), in the order of shapelet_variant_index: X(name) is expanded for each one
+#define SHAPELET_VARIANTS(X) \
+    X(algebric_pow) X(algebric_abs) X(zscore_pow) X(zscore_abs) X(zscore_expected_pow) X(zscore_expected_abs)
+
+// Index of the variant of config in SHAPELET_VARIANTS, exits when the config is unknown or not supported by the build
+uint8_t shapelet_variant_index(const Shapelet_config *config);
+
+// Config matching the defines of the build
+Shapelet_config default_shapelet_config(void);
+
+// Reads a variant name, as in the binaries of script_2norms_2dists.sh (the [variant] argument of the programs): algebric_pow, algebric_abs, zscore_pow, zscore_abs,
+// zscore_expected_pow or zscore_expected_abs. Returns 0 when the name is unknown
+int parse_shapelet_config(const char *name, Shapelet_config *config);
+
+// Name of the variant of config
+const char *shapelet_config_name(const Shapelet_config *config);
+
+// Same as the functions of shapelet_transform.h, computed by the variant of config
+void config_normalize_values(const Shapelet_config *config, numeric_type *values, uint32_t length);
+// The shapelets returned by a selection must be transformed with the same config
+Shapelet *config_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, uint16_t k);
+Shapelet *config_multi_thread_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_of_ts, uint16_t min, uint16_t max, 
+                                                        uint16_t k, uint16_t num_threads);
+Shapelet *config_omp_shapelet_cached_selection(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, uint16_t min, uint16_t max, uint16_t k);
+numeric_type config_shapelet_ts_distance(const Shapelet_config *config, Shapelet *pivot_shapelet, const Timeseries *time_series);
+numeric_type **config_transform_dataset(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, uint16_t num_shapelets);
+numeric_type **config_transform_dataset_locations(const Shapelet_config *config, Timeseries *T, uint16_t num_ts, Shapelet *shapelet_set, 
+                                                  uint16_t num_shapelets, uint32_t ***match_windows);
+
+#endif
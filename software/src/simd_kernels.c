@@ -0,0 +1,576 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "simd_kernels.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+typedef float (*distance_kernel)(const float *, const float *, uint32_t, float, float, float, Simd_abandon_mode);
+typedef float (*ordered_distance_kernel)(const float *, const float *, const uint32_t *, uint32_t, float, float, float, Simd_abandon_mode);
+
+// Kernels selected by simd_kernels_init, scalar until then
+static struct{
+    const char *isa;
+    distance_kernel squared_distance;
+    distance_kernel absolute_distance;
+    ordered_distance_kernel ordered_squared_distance;
+    ordered_distance_kernel ordered_absolute_distance;
+    float (*sum)(const float *, uint32_t);
+    float (*centered_squares_sum)(const float *, uint32_t, float);
+    void (*standardize)(float *, uint32_t, float, float);
+} kernels;
+
+
+// Bit pattern above which a non-negative float has a larger exponent than current_minimum_distance (INFINITY never abandons)
+static inline int32_t exponent_threshold(float current_minimum_distance){
+    uint32_t bits;
+    memcpy(&bits, &current_minimum_distance, sizeof(bits));
+    return (int32_t) (bits | 0x007FFFFF);
+}
+
+
+// SCALAR
+static inline int block_abandoned_scalar(float total_distance, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    int32_t bits;
+    
+    if (abandon_mode == SIMD_ABANDON_EXACT)
+        return total_distance >= current_minimum_distance;
+    memcpy(&bits, &total_distance, sizeof(bits));
+    return bits > exponent_threshold(current_minimum_distance);
+}
+
+
+// Plain loops with the same block structure as the vector kernels, left for the compiler to vectorize
+static float squared_distance_scalar(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    float difference, total_distance = 0;
+    uint32_t i = 0;
+
+    while (i < length){
+        const uint32_t block_end = (length - i > SIMD_ABANDON_BLOCK) ? i + SIMD_ABANDON_BLOCK : length;
+        for (; i < block_end; i++){
+            difference = pivot_values[i] - (target_values[i] - offset) * scale;
+            total_distance += difference * difference;
+        }
+        if (block_abandoned_scalar(total_distance, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+static float absolute_distance_scalar(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    float total_distance = 0;
+    uint32_t i = 0;
+
+    while (i < length){
+        const uint32_t block_end = (length - i > SIMD_ABANDON_BLOCK) ? i + SIMD_ABANDON_BLOCK : length;
+        for (; i < block_end; i++)
+            total_distance += fabsf(pivot_values[i] - (target_values[i] - offset) * scale);
+        if (block_abandoned_scalar(total_distance, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+static float ordered_squared_distance_scalar(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    float difference, total_distance = 0;
+    uint32_t i = 0;
+
+    while (i < length){
+        const uint32_t block_end = (length - i > SIMD_ABANDON_BLOCK) ? i + SIMD_ABANDON_BLOCK : length;
+        for (; i < block_end; i++){
+            difference = pivot_values[i] - (target_values[order[i]] - offset) * scale;
+            total_distance += difference * difference;
+        }
+        if (block_abandoned_scalar(total_distance, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+static float ordered_absolute_distance_scalar(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    float total_distance = 0;
+    uint32_t i = 0;
+
+    while (i < length){
+        const uint32_t block_end = (length - i > SIMD_ABANDON_BLOCK) ? i + SIMD_ABANDON_BLOCK : length;
+        for (; i < block_end; i++)
+            total_distance += fabsf(pivot_values[i] - (target_values[order[i]] - offset) * scale);
+        if (block_abandoned_scalar(total_distance, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+static float sum_scalar(const float *values, uint32_t length){
+    float sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        sum += values[i];
+    return sum;
+}
+
+
+static float centered_squares_sum_scalar(const float *values, uint32_t length, float center){
+    float squares_sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        squares_sum += (values[i] - center) * (values[i] - center);
+    return squares_sum;
+}
+
+
+static void standardize_scalar(float *values, uint32_t length, float offset, float divisor){
+    for (uint32_t i = 0; i < length; i++)
+        values[i] = (values[i] - offset) / divisor;
+}
+
+
+#ifdef SIMD_X86
+// AVX2: 8 floats per step, tails handled by scalar code
+__attribute__((target("avx2,fma")))
+static inline float horizontal_sum_avx2(__m256 vector){
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(vector), _mm256_extractf128_ps(vector, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    return _mm_cvtss_f32(sum);
+}
+
+
+// Any lane over the exponent threshold abandons, a single vector compare for the whole block
+__attribute__((target("avx2,fma")))
+static inline int block_abandoned_avx2(__m256 accumulator, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    if (abandon_mode == SIMD_ABANDON_EXACT)
+        return horizontal_sum_avx2(accumulator) >= current_minimum_distance;
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_castps_si256(accumulator), _mm256_set1_epi32(exponent_threshold(current_minimum_distance))))) != 0;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float squared_distance_avx2(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m256 offsets = _mm256_set1_ps(offset), scales = _mm256_set1_ps(scale);
+    __m256 differences, accumulator = _mm256_setzero_ps();
+    float difference, total_distance;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 8){
+            differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&target_values[i]), offsets), scales));
+            accumulator = _mm256_fmadd_ps(differences, differences, accumulator);
+        }
+        if (block_abandoned_avx2(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i + 8 <= length; i += 8){
+        differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&target_values[i]), offsets), scales));
+        accumulator = _mm256_fmadd_ps(differences, differences, accumulator);
+    }
+    total_distance = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++){
+        difference = pivot_values[i] - (target_values[i] - offset) * scale;
+        total_distance += difference * difference;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float absolute_distance_avx2(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m256 offsets = _mm256_set1_ps(offset), scales = _mm256_set1_ps(scale);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 differences, accumulator = _mm256_setzero_ps();
+    float total_distance;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 8){
+            differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&target_values[i]), offsets), scales));
+            accumulator = _mm256_add_ps(accumulator, _mm256_andnot_ps(sign_mask, differences));
+        }
+        if (block_abandoned_avx2(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i + 8 <= length; i += 8){
+        differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&target_values[i]), offsets), scales));
+        accumulator = _mm256_add_ps(accumulator, _mm256_andnot_ps(sign_mask, differences));
+    }
+    total_distance = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++)
+        total_distance += fabsf(pivot_values[i] - (target_values[i] - offset) * scale);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float ordered_squared_distance_avx2(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m256 offsets = _mm256_set1_ps(offset), scales = _mm256_set1_ps(scale);
+    __m256 targets, differences, accumulator = _mm256_setzero_ps();
+    float difference, total_distance;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 8){
+            targets = _mm256_i32gather_ps(target_values, _mm256_loadu_si256((const __m256i *) &order[i]), 4);
+            differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(targets, offsets), scales));
+            accumulator = _mm256_fmadd_ps(differences, differences, accumulator);
+        }
+        if (block_abandoned_avx2(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i + 8 <= length; i += 8){
+        targets = _mm256_i32gather_ps(target_values, _mm256_loadu_si256((const __m256i *) &order[i]), 4);
+        differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(targets, offsets), scales));
+        accumulator = _mm256_fmadd_ps(differences, differences, accumulator);
+    }
+    total_distance = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++){
+        difference = pivot_values[i] - (target_values[order[i]] - offset) * scale;
+        total_distance += difference * difference;
+    }
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float ordered_absolute_distance_avx2(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m256 offsets = _mm256_set1_ps(offset), scales = _mm256_set1_ps(scale);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 targets, differences, accumulator = _mm256_setzero_ps();
+    float total_distance;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 8){
+            targets = _mm256_i32gather_ps(target_values, _mm256_loadu_si256((const __m256i *) &order[i]), 4);
+            differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(targets, offsets), scales));
+            accumulator = _mm256_add_ps(accumulator, _mm256_andnot_ps(sign_mask, differences));
+        }
+        if (block_abandoned_avx2(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i + 8 <= length; i += 8){
+        targets = _mm256_i32gather_ps(target_values, _mm256_loadu_si256((const __m256i *) &order[i]), 4);
+        differences = _mm256_sub_ps(_mm256_loadu_ps(&pivot_values[i]), _mm256_mul_ps(_mm256_sub_ps(targets, offsets), scales));
+        accumulator = _mm256_add_ps(accumulator, _mm256_andnot_ps(sign_mask, differences));
+    }
+    total_distance = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++)
+        total_distance += fabsf(pivot_values[i] - (target_values[order[i]] - offset) * scale);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float sum_avx2(const float *values, uint32_t length){
+    __m256 accumulator = _mm256_setzero_ps();
+    float sum;
+    uint32_t i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        accumulator = _mm256_add_ps(accumulator, _mm256_loadu_ps(&values[i]));
+    sum = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float centered_squares_sum_avx2(const float *values, uint32_t length, float center){
+    const __m256 centers = _mm256_set1_ps(center);
+    __m256 differences, accumulator = _mm256_setzero_ps();
+    float squares_sum;
+    uint32_t i = 0;
+
+    for (; i + 8 <= length; i += 8){
+        differences = _mm256_sub_ps(_mm256_loadu_ps(&values[i]), centers);
+        accumulator = _mm256_fmadd_ps(differences, differences, accumulator);
+    }
+    squares_sum = horizontal_sum_avx2(accumulator);
+    for (; i < length; i++)
+        squares_sum += (values[i] - center) * (values[i] - center);
+
+    return squares_sum;
+}
+
+
+__attribute__((target("avx2,fma")))
+static void standardize_avx2(float *values, uint32_t length, float offset, float divisor){
+    const __m256 offsets = _mm256_set1_ps(offset), divisors = _mm256_set1_ps(divisor);
+    uint32_t i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        _mm256_storeu_ps(&values[i], _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(&values[i]), offsets), divisors));
+    for (; i < length; i++)
+        values[i] = (values[i] - offset) / divisor;
+}
+
+
+// AVX-512: 16 floats per step, tails handled by masked loads
+__attribute__((target("avx512f")))
+static inline __mmask16 tail_mask_avx512(uint32_t remaining){
+    return (remaining >= 16) ? (__mmask16) 0xFFFF : (__mmask16) ((1u << remaining) - 1);
+}
+
+
+__attribute__((target("avx512f")))
+static inline int block_abandoned_avx512(__m512 accumulator, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    if (abandon_mode == SIMD_ABANDON_EXACT)
+        return _mm512_reduce_add_ps(accumulator) >= current_minimum_distance;
+    return _mm512_cmpgt_epi32_mask(_mm512_castps_si512(accumulator), _mm512_set1_epi32(exponent_threshold(current_minimum_distance))) != 0;
+}
+
+
+__attribute__((target("avx512f")))
+static float squared_distance_avx512(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m512 offsets = _mm512_set1_ps(offset), scales = _mm512_set1_ps(scale);
+    __m512 differences, accumulator = _mm512_setzero_ps();
+    float total_distance;
+    __mmask16 mask;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 16){
+            differences = _mm512_sub_ps(_mm512_loadu_ps(&pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(&target_values[i]), offsets), scales));
+            accumulator = _mm512_fmadd_ps(differences, differences, accumulator);
+        }
+        if (block_abandoned_avx512(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i < length; i += 16){
+        // Lanes out of the mask keep the accumulator untouched
+        mask = tail_mask_avx512(length - i);
+        differences = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &target_values[i]), offsets), scales));
+        accumulator = _mm512_mask3_fmadd_ps(differences, differences, accumulator, mask);
+    }
+    total_distance = _mm512_reduce_add_ps(accumulator);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx512f")))
+static float absolute_distance_avx512(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m512 offsets = _mm512_set1_ps(offset), scales = _mm512_set1_ps(scale);
+    __m512 differences, accumulator = _mm512_setzero_ps();
+    float total_distance;
+    __mmask16 mask;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 16){
+            differences = _mm512_sub_ps(_mm512_loadu_ps(&pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(&target_values[i]), offsets), scales));
+            accumulator = _mm512_add_ps(accumulator, _mm512_abs_ps(differences));
+        }
+        if (block_abandoned_avx512(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i < length; i += 16){
+        mask = tail_mask_avx512(length - i);
+        differences = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &target_values[i]), offsets), scales));
+        accumulator = _mm512_mask_add_ps(accumulator, mask, accumulator, _mm512_abs_ps(differences));
+    }
+    total_distance = _mm512_reduce_add_ps(accumulator);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+// Masked gather of target[order[i]], lanes out of the mask are zero and never dereferenced
+__attribute__((target("avx512f")))
+static inline __m512 ordered_load_avx512(const float *target_values, const uint32_t *order, __mmask16 mask){
+    return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, _mm512_maskz_loadu_epi32(mask, order), target_values, 4);
+}
+
+
+__attribute__((target("avx512f")))
+static float ordered_squared_distance_avx512(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m512 offsets = _mm512_set1_ps(offset), scales = _mm512_set1_ps(scale);
+    __m512 differences, accumulator = _mm512_setzero_ps();
+    float total_distance;
+    __mmask16 mask;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 16){
+            differences = _mm512_sub_ps(_mm512_loadu_ps(&pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(ordered_load_avx512(target_values, &order[i], 0xFFFF), offsets), scales));
+            accumulator = _mm512_fmadd_ps(differences, differences, accumulator);
+        }
+        if (block_abandoned_avx512(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i < length; i += 16){
+        mask = tail_mask_avx512(length - i);
+        differences = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(ordered_load_avx512(target_values, &order[i], mask), offsets), scales));
+        accumulator = _mm512_mask3_fmadd_ps(differences, differences, accumulator, mask);
+    }
+    total_distance = _mm512_reduce_add_ps(accumulator);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx512f")))
+static float ordered_absolute_distance_avx512(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    const __m512 offsets = _mm512_set1_ps(offset), scales = _mm512_set1_ps(scale);
+    __m512 differences, accumulator = _mm512_setzero_ps();
+    float total_distance;
+    __mmask16 mask;
+    uint32_t i = 0;
+
+    for (; i + SIMD_ABANDON_BLOCK <= length; ){
+        for (const uint32_t block_end = i + SIMD_ABANDON_BLOCK; i < block_end; i += 16){
+            differences = _mm512_sub_ps(_mm512_loadu_ps(&pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(ordered_load_avx512(target_values, &order[i], 0xFFFF), offsets), scales));
+            accumulator = _mm512_add_ps(accumulator, _mm512_abs_ps(differences));
+        }
+        if (block_abandoned_avx512(accumulator, current_minimum_distance, abandon_mode)) return INFINITY;
+    }
+    for (; i < length; i += 16){
+        mask = tail_mask_avx512(length - i);
+        differences = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &pivot_values[i]), _mm512_mul_ps(_mm512_sub_ps(ordered_load_avx512(target_values, &order[i], mask), offsets), scales));
+        accumulator = _mm512_mask_add_ps(accumulator, mask, accumulator, _mm512_abs_ps(differences));
+    }
+    total_distance = _mm512_reduce_add_ps(accumulator);
+
+    return (total_distance >= current_minimum_distance) ? INFINITY : total_distance;
+}
+
+
+__attribute__((target("avx512f")))
+static float sum_avx512(const float *values, uint32_t length){
+    __m512 accumulator = _mm512_setzero_ps();
+
+    for (uint32_t i = 0; i < length; i += 16)
+        accumulator = _mm512_add_ps(accumulator, _mm512_maskz_loadu_ps(tail_mask_avx512(length - i), &values[i]));
+
+    return _mm512_reduce_add_ps(accumulator);
+}
+
+
+__attribute__((target("avx512f")))
+static float centered_squares_sum_avx512(const float *values, uint32_t length, float center){
+    const __m512 centers = _mm512_set1_ps(center);
+    __m512 differences, accumulator = _mm512_setzero_ps();
+    __mmask16 mask;
+
+    for (uint32_t i = 0; i < length; i += 16){
+        mask = tail_mask_avx512(length - i);
+        differences = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &values[i]), centers);
+        accumulator = _mm512_mask3_fmadd_ps(differences, differences, accumulator, mask);
+    }
+
+    return _mm512_reduce_add_ps(accumulator);
+}
+
+
+__attribute__((target("avx512f")))
+static void standardize_avx512(float *values, uint32_t length, float offset, float divisor){
+    const __m512 offsets = _mm512_set1_ps(offset), divisors = _mm512_set1_ps(divisor);
+    __mmask16 mask;
+
+    for (uint32_t i = 0; i < length; i += 16){
+        mask = tail_mask_avx512(length - i);
+        _mm512_mask_storeu_ps(&values[i], mask, _mm512_div_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &values[i]), offsets), divisors));
+    }
+}
+#endif
+
+
+// DISPATCH
+// Runs before main, so the kernel table is never written while selection threads are running
+__attribute__((constructor))
+static void simd_kernels_init(void){
+    const char *requested_isa = getenv("SHAPELET_SIMD_ISA");
+
+    kernels.isa = "scalar";
+    kernels.squared_distance = squared_distance_scalar;
+    kernels.absolute_distance = absolute_distance_scalar;
+    kernels.ordered_squared_distance = ordered_squared_distance_scalar;
+    kernels.ordered_absolute_distance = ordered_absolute_distance_scalar;
+    kernels.sum = sum_scalar;
+    kernels.centered_squares_sum = centered_squares_sum_scalar;
+    kernels.standardize = standardize_scalar;
+
+    #ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (requested_isa != NULL && strcmp(requested_isa, "scalar") == 0)
+        return;
+
+    if (__builtin_cpu_supports("avx512f") && (requested_isa == NULL || strcmp(requested_isa, "avx512") == 0)){
+        kernels.isa = "avx512";
+        kernels.squared_distance = squared_distance_avx512;
+        kernels.absolute_distance = absolute_distance_avx512;
+        kernels.ordered_squared_distance = ordered_squared_distance_avx512;
+        kernels.ordered_absolute_distance = ordered_absolute_distance_avx512;
+        kernels.sum = sum_avx512;
+        kernels.centered_squares_sum = centered_squares_sum_avx512;
+        kernels.standardize = standardize_avx512;
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+        kernels.isa = "avx2";
+        kernels.squared_distance = squared_distance_avx2;
+        kernels.absolute_distance = absolute_distance_avx2;
+        kernels.ordered_squared_distance = ordered_squared_distance_avx2;
+        kernels.ordered_absolute_distance = ordered_absolute_distance_avx2;
+        kernels.sum = sum_avx2;
+        kernels.centered_squares_sum = centered_squares_sum_avx2;
+        kernels.standardize = standardize_avx2;
+    }
+    #else
+    (void) requested_isa;
+    #endif
+}
+
+
+const char *simd_kernels_isa(void){
+    return kernels.isa;
+}
+
+
+float simd_squared_distance(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    return kernels.squared_distance(pivot_values, target_values, length, offset, scale, current_minimum_distance, abandon_mode);
+}
+
+
+float simd_absolute_distance(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    return kernels.absolute_distance(pivot_values, target_values, length, offset, scale, current_minimum_distance, abandon_mode);
+}
+
+
+float simd_ordered_squared_distance(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    return kernels.ordered_squared_distance(pivot_values, target_values, order, length, offset, scale, current_minimum_distance, abandon_mode);
+}
+
+
+float simd_ordered_absolute_distance(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode){
+    return kernels.ordered_absolute_distance(pivot_values, target_values, order, length, offset, scale, current_minimum_distance, abandon_mode);
+}
+
+
+float simd_sum(const float *values, uint32_t length){
+    return kernels.sum(values, length);
+}
+
+
+float simd_centered_squares_sum(const float *values, uint32_t length, float center){
+    return kernels.centered_squares_sum(values, length, center);
+}
+
+
+void simd_standardize(float *values, uint32_t length, float offset, float divisor){
+    kernels.standardize(values, length, offset, divisor);
+}
@@ -0,0 +1,62 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _SIMD_KERNELS_H
+#define _SIMD_KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Number of elements accumulated between two early abandon checks (multiple of 16)
+#define SIMD_ABANDON_BLOCK 32
+
+// Early abandon check done at the end of each block
+// SIMD_ABANDON_EXACT compares the partial sum with the minimum distance, SIMD_ABANDON_EXPONENT emulates shapelet_distance.vhd:
+// the block is abandoned once the exponent of any lane of the accumulator exceeds the exponent of the minimum distance,
+// an integer compare on the float bit patterns that needs no horizontal sum. Lanes are non-negative partial sums, so it abandons
+// no more than the exact check, and the final distance is always compared exactly
+typedef enum{
+    SIMD_ABANDON_EXACT,
+    SIMD_ABANDON_EXPONENT
+} Simd_abandon_mode;
+
+// Floating point vector kernels, dispatched once at program start to AVX-512, AVX2 or scalar code according to the CPU features
+// The environment variable SHAPELET_SIMD_ISA ("avx512", "avx2" or "scalar") restricts the dispatch, for testing purposes
+
+// Name of the instruction set selected by the dispatcher
+const char *simd_kernels_isa(void);
+
+// Sum of (pivot[i] - (target[i] - offset) * scale)^2, or INFINITY once the partial sum reaches current_minimum_distance
+// The abandon condition is checked once every SIMD_ABANDON_BLOCK elements
+float simd_squared_distance(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode);
+
+// Same as simd_squared_distance with |pivot[i] - (target[i] - offset) * scale| (USE_ABS)
+float simd_absolute_distance(const float *pivot_values, const float *target_values, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode);
+
+// Same as simd_squared_distance and simd_absolute_distance with the target gathered as target[order[i]]
+// (pivot_values already permuted, as used by the reordered early abandon)
+float simd_ordered_squared_distance(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode);
+float simd_ordered_absolute_distance(const float *pivot_values, const float *target_values, const uint32_t *order, uint32_t length, float offset, float scale, float current_minimum_distance, Simd_abandon_mode abandon_mode);
+
+// Sum of values[i]
+float simd_sum(const float *values, uint32_t length);
+
+// Sum of (values[i] - center)^2
+float simd_centered_squares_sum(const float *values, uint32_t length, float center);
+
+// values[i] = (values[i] - offset) / divisor
+void simd_standardize(float *values, uint32_t length, float offset, float divisor);
+
+#endif
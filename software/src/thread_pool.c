@@ -0,0 +1,243 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include "fft.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define POOL_DEQUE_INITIAL_CAPACITY 64
+
+// Worker running on the calling thread, NULL outside the pools
+static __thread Pool_worker *current_worker = NULL;
+
+
+static void deque_init(Pool_deque *deque){
+    deque->capacity = POOL_DEQUE_INITIAL_CAPACITY;
+    deque->tasks = malloc(deque->capacity * sizeof(*deque->tasks));
+    if (deque->tasks == NULL){
+        perror("Error allocating task deque!\n");
+        exit(errno);
+    }
+    deque->top = 0;
+    deque->num_tasks = 0;
+    pthread_mutex_init(&deque->mutex, NULL);
+}
+
+
+static void deque_push(Pool_deque *deque, Pool_task task){
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->num_tasks == deque->capacity){
+        // Unroll the ring into a buffer twice as large
+        Pool_task *tasks = malloc(2 * deque->capacity * sizeof(*tasks));
+        if (tasks == NULL){
+            perror("Error growing task deque!\n");
+            exit(errno);
+        }
+        for (uint32_t i = 0; i < deque->num_tasks; i++)
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity *= 2;
+        deque->top = 0;
+    }
+    deque->tasks[(deque->top + deque->num_tasks) % deque->capacity] = task;
+    deque->num_tasks++;
+    pthread_mutex_unlock(&deque->mutex);
+}
+
+
+// Takes the newest task (owner) or the oldest one (thief), returns 0 when the deque is empty
+static int deque_take(Pool_deque *deque, int steal, Pool_task *task){
+    int taken = 0;
+    
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->num_tasks > 0){
+        if (steal){
+            *task = deque->tasks[deque->top];
+            deque->top = (deque->top + 1) % deque->capacity;
+        }
+        else{
+            *task = deque->tasks[(deque->top + deque->num_tasks - 1) % deque->capacity];
+        }
+        deque->num_tasks--;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    
+    return taken;
+}
+
+
+// Own deque first, then the other deques starting from the next worker
+static int find_task(Thread_pool *pool, uint16_t id, Pool_task *task){
+    if (deque_take(&pool->deques[id], 0, task))
+        return 1;
+    for (uint16_t i = 1; i < pool->num_threads; i++){
+        if (deque_take(&pool->deques[(id + i) % pool->num_threads], 1, task))
+            return 1;
+    }
+    return 0;
+}
+
+
+static void *pool_worker(void *arg){
+    Pool_worker *worker = (Pool_worker *) arg;
+    Thread_pool *pool = worker->pool;
+    Pool_task task;
+    
+    current_worker = worker;
+    for (;;){
+        if (find_task(pool, worker->id, &task)){
+            pthread_mutex_lock(&pool->mutex);
+            pool->num_queued--;
+            pthread_mutex_unlock(&pool->mutex);
+            
+            task.function(task.arg);
+            
+            pthread_mutex_lock(&pool->mutex);
+            pool->num_unfinished--;
+            if (pool->num_unfinished == 0)
+                pthread_cond_broadcast(&pool->all_finished);
+            pthread_mutex_unlock(&pool->mutex);
+            continue;
+        }
+        
+        // Sleep until a task is queued (tasks are counted before they can be taken and uncounted after, so no task is missed)
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->num_queued == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work_available, &pool->mutex);
+        if (pool->num_queued == 0 && pool->shutdown){
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    
+    // The tasks draw their temporaries from the scratch arena of the worker, and MASS caches its FFT twiddle factors per thread
+    scratch_destroy();
+    fft_free_twiddles();
+    current_worker = NULL;
+    return NULL;
+}
+
+
+Thread_pool *thread_pool_create(uint16_t num_threads){
+    Thread_pool *pool;
+    
+    if (num_threads == 0){
+        printf("Error, a thread pool needs at least one thread\n");
+        exit(-1);
+    }
+    
+    pool = malloc(sizeof(*pool));
+    if (pool == NULL){
+        perror("Error allocating thread pool!\n");
+        exit(errno);
+    }
+    pool->num_threads = num_threads;
+    pool->threads = malloc(num_threads * sizeof(*pool->threads));
+    pool->workers = malloc(num_threads * sizeof(*pool->workers));
+    pool->deques = malloc(num_threads * sizeof(*pool->deques));
+    if (pool->threads == NULL || pool->workers == NULL || pool->deques == NULL){
+        perror("Error allocating thread pool!\n");
+        exit(errno);
+    }
+    pool->next_deque = 0;
+    pool->num_queued = 0;
+    pool->num_unfinished = 0;
+    pool->shutdown = 0;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->all_finished, NULL);
+    
+    for (uint16_t i = 0; i < num_threads; i++)
+        deque_init(&pool->deques[i]);
+    for (uint16_t i = 0; i < num_threads; i++){
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, &pool->workers[i])){
+            perror("Error creating thread\n");
+            exit(errno);
+        }
+    }
+    
+    return pool;
+}
+
+
+void thread_pool_submit(Thread_pool *pool, Pool_function function, void *arg){
+    Pool_task task = {function, arg};
+    uint16_t deque;
+    
+    pthread_mutex_lock(&pool->mutex);
+    pool->num_unfinished++;
+    if (current_worker != NULL && current_worker->pool == pool){
+        deque = current_worker->id;
+    }
+    else{
+        deque = pool->next_deque;
+        pool->next_deque = (pool->next_deque + 1) % pool->num_threads;
+    }
+    // Pushed and counted under the pool mutex, so a worker can only take the task (and decrement num_queued) once it is counted
+    // (workers never hold a deque mutex while waiting for the pool mutex)
+    deque_push(&pool->deques[deque], task);
+    pool->num_queued++;
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+
+int32_t thread_pool_worker_id(void){
+    return (current_worker != NULL) ? current_worker->id : -1;
+}
+
+
+void thread_pool_wait(Thread_pool *pool){
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->num_unfinished > 0)
+        pthread_cond_wait(&pool->all_finished, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+
+void thread_pool_destroy(Thread_pool *pool){
+    thread_pool_wait(pool);
+    
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->mutex);
+    
+    for (uint16_t i = 0; i < pool->num_threads; i++){
+        if (pthread_join(pool->threads[i], NULL)){
+            perror("Error joining threads!\n");
+            exit(errno);
+        }
+    }
+    
+    for (uint16_t i = 0; i < pool->num_threads; i++){
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_cond_destroy(&pool->all_finished);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
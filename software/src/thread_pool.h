@@ -0,0 +1,79 @@
+// Copyright GMicro UFSM 2021
+// This source describes Open Hardware and is licensed under the CERN-OHLS v2
+// You may redistribute and modify this documentation and make products
+// using it under the terms of the CERN-OHL-S v2 (https:/cern.ch/cern-ohl).
+// This documentation is distributed WITHOUT ANY EXPRESS OR IMPLIED
+// WARRANTY, INCLUDING OF MERCHANTABILITY, SATISFACTORY QUALITY
+// AND FITNESS FOR A PARTICULAR PURPOSE. Please see the CERN-OHL-S v2
+// for applicable conditions.
+// Source location: https://github.com/vctrop/shapelet_distance_hardware_accelerator
+// As per CERN-OHL-S v2 section 4, should You produce hardware based on
+// these sources, You must maintain the Source Location visible on any
+// product you make using this documentation.
+
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+// Persistent pool of worker threads with one task deque per worker (work stealing)
+// A worker runs the tasks of its own deque from the most recently pushed one, and when it runs out of work steals the
+// oldest task of another deque, so that no core idles while any task is left. Tasks submitted from outside the pool are
+// spread over the deques in round robin, tasks submitted by a worker go to its own deque
+
+typedef void (*Pool_function)(void *arg);
+
+typedef struct{
+    Pool_function function;
+    void *arg;
+} Pool_task;
+
+// Ring buffer of tasks, grown when full
+typedef struct{
+    Pool_task *tasks;
+    uint32_t capacity;
+    uint32_t top;                       // Index of the oldest task (stolen by other workers)
+    uint32_t num_tasks;
+    pthread_mutex_t mutex;
+} Pool_deque;
+
+typedef struct Thread_pool Thread_pool;
+
+typedef struct{
+    Thread_pool *pool;
+    uint16_t id;
+} Pool_worker;
+
+struct Thread_pool{
+    uint16_t num_threads;
+    pthread_t *threads;
+    Pool_worker *workers;
+    Pool_deque *deques;
+    uint16_t next_deque;                // Deque of the next task submitted from outside the pool
+    uint64_t num_queued;                // Tasks waiting in the deques
+    uint64_t num_unfinished;            // Tasks submitted and not finished yet
+    uint8_t shutdown;
+    pthread_mutex_t mutex;              // Protects the counters above, together with the conditions below
+    pthread_cond_t work_available;
+    pthread_cond_t all_finished;
+};
+
+// Starts num_threads workers, which wait for tasks until the pool is destroyed (DESTROY WITH thread_pool_destroy)
+Thread_pool *thread_pool_create(uint16_t num_threads);
+
+// Queues function(arg) to be run by one of the workers
+void thread_pool_submit(Thread_pool *pool, Pool_function function, void *arg);
+
+// Index of the worker running the calling thread (0 to num_threads - 1), -1 outside the pools
+int32_t thread_pool_worker_id(void);
+
+// Blocks until every submitted task has finished, including the tasks submitted by other tasks meanwhile
+void thread_pool_wait(Thread_pool *pool);
+
+// Waits for the submitted tasks, then stops and frees the workers
+void thread_pool_destroy(Thread_pool *pool);
+
+#endif
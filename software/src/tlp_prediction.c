@@ -30,17 +30,25 @@ int main(int argc, char *argv[]){
     uint16_t num_nodes;
     float **hidden_weights;
     float *out_weights; 
+    Shapelet_config config = default_shapelet_config();
     
-    if(argc != 3){
-        fprintf(stderr, "Please use: %s {'s'/'r'} {num_hidden_nodes} \n", argv[0]);
+    // Optionally the normalization and distance of the shapelets (the ones of the build by default)
+    if(argc != 3 && argc != 4){
+        fprintf(stderr, "Please use: %s {'s'/'r'} {num_hidden_nodes} [variant]\n", argv[0]);
+        fprintf(stderr, "variant: algebric_pow, algebric_abs, zscore_pow, zscore_abs, zscore_expected_pow or zscore_expected_abs\n");
         exit(-1);
     }
     
     hidden_activation = argv[1][0];
     num_nodes = atof(argv[2]);
+    if(argc == 4 && !parse_shapelet_config(argv[3], &config)){
+        fprintf(stderr, "Error: unknown variant %s\n", argv[3]);
+        exit(-1);
+    }
     
     // Load dataset
     num_ts = read_dataset(dataset_filename, &ts_dataset);
+    build_stats_index(ts_dataset, num_ts, STATS_INDEX_MAX_BYTES);
     
     // Load shapelet set
     shapelet_array = safe_alloc(num_shapelets * sizeof(*shapelet_array));
@@ -52,15 +60,15 @@ int main(int argc, char *argv[]){
     
     // printf("Normalized shapelets\n");
     for (uint16_t i = 0; i < num_shapelets; i++){
-        zscore_normalization(normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
+        config_normalize_values(&config, normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
         
         // printf("[%u] Length: %u, first: %g, last: %g\n", i, normalized_shapelet_array[i].length,
                 // normalized_shapelet_array[i].values[0], normalized_shapelet_array[i].values[normalized_shapelet_array[i].length - 1]);
         // comp_mean_std(normalized_shapelet_array[i].values, normalized_shapelet_array[i].length);
     }
     
-    // Transform the dataset with the already normalized shapelets
-    transformed_dataset = profiling_transform_dataset(ts_dataset, num_ts, normalized_shapelet_array, num_shapelets);
+    // Transform the dataset with the already normalized shapelets (normalized and compared by the same variant)
+    transformed_dataset = config_profiling_transform_dataset(&config, ts_dataset, num_ts, normalized_shapelet_array, num_shapelets);
     
     // Randomize weights of hidden and output nodes
     srand((unsigned) time(NULL));